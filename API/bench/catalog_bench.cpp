@@ -0,0 +1,132 @@
+/* Author: Jan Šulák
+ * Description: Startup time, resident memory and lookup speed of the city catalog with 200k generated cities.
+ * Date: 9.December 2024
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "city_catalog.h"
+#include "city_index.h"
+#include "city_registry.h"
+
+using namespace std;
+
+const size_t CITIES = 200000;
+const int LOOKUPS = 1000000;
+const int SEARCHES = 10000;
+
+// Function to read the resident set size of the process in kB
+static long residentKb()
+{
+    ifstream statm("/proc/self/statm");
+    long size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Function to generate a pronounceable city name of a few syllables
+static string cityName(mt19937 &random)
+{
+    static const char *const SYLLABLES[] = {"ba", "ber", "bru", "ca", "dor", "en", "fel", "gra", "ham", "ka", "lin", "ma", "no",
+                                            "ost", "pa", "ra", "ri", "sen", "stad", "ta", "ton", "vi", "wa", "zel"};
+    const size_t count = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+    string name;
+    int syllables = 2 + static_cast<int>(random() % 3);
+    for (int i = 0; i < syllables; ++i)
+    {
+        name += SYLLABLES[random() % count];
+    }
+    name[0] = static_cast<char>(name[0] - 'a' + 'A');
+    return name;
+}
+
+static double elapsedMs(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    char path[] = "/tmp/city_catalog_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        cerr << "Failed to create the catalog file" << endl;
+        return 1;
+    }
+    close(fd);
+
+    mt19937 random(42);
+    vector<string> names;
+    {
+        ofstream out(path);
+        out << "# id\tname\tcountry\tlatitude\tlongitude\n";
+        for (size_t i = 0; i < CITIES; ++i)
+        {
+            names.push_back(cityName(random) + (i % 4 == 0 ? " " + to_string(i) : ""));
+            out << 1000000 + i << "\t" << names.back() << "\tCZ\t" << (random() % 18000) / 100.0 - 90 << "\t"
+                << (random() % 36000) / 100.0 - 180 << "\n";
+        }
+    }
+
+    long baseline = residentKb();
+    auto start = chrono::steady_clock::now();
+    CityCatalog catalog;
+    if (!catalog.load(path))
+    {
+        remove(path);
+        return 1;
+    }
+    double loadMs = elapsedMs(start);
+    long catalogKb = residentKb();
+
+    start = chrono::steady_clock::now();
+    CityRegistry cities({{"Brno", 3078610}}, catalog);
+    double registryMs = elapsedMs(start);
+    long registryKb = residentKb();
+
+    start = chrono::steady_clock::now();
+    CityIndex index(cities);
+    double indexMs = elapsedMs(start);
+    long indexKb = residentKb();
+
+    cout << "cities: " << catalog.size() << " in catalog, " << cities.size() << " unique names" << endl;
+    cout << "catalog: " << loadMs << " ms, +" << catalogKb - baseline << " kB resident" << endl;
+    cout << "registry: " << registryMs << " ms, +" << registryKb - catalogKb << " kB resident" << endl;
+    cout << "index: " << indexMs << " ms, +" << indexKb - registryKb << " kB resident" << endl;
+    cout << "startup: " << loadMs + registryMs + indexMs << " ms, +" << indexKb - baseline << " kB resident" << endl;
+
+    long checksum = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        checksum += cities.find(names[static_cast<size_t>(i) % names.size()]);
+    }
+    cout << "find: " << elapsedMs(start) * 1e6 / LOOKUPS << " ns/lookup" << endl;
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < SEARCHES; ++i)
+    {
+        checksum += static_cast<long>(index.prefix(names[static_cast<size_t>(i) * 7 % names.size()].substr(0, 4)).size());
+    }
+    cout << "prefix: " << elapsedMs(start) * 1e3 / SEARCHES << " us/search of 4 characters" << endl;
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < SEARCHES; ++i)
+    {
+        const string &name = names[static_cast<size_t>(i) * 13 % names.size()];
+        checksum += static_cast<long>(index.contains(name.substr(name.size() / 2, 4)).size());
+    }
+    cout << "contains: " << elapsedMs(start) * 1e3 / SEARCHES << " us/search of 4 characters" << endl;
+    cout << "checksum: " << checksum << endl;
+
+    remove(path);
+    return 0;
+}
@@ -0,0 +1,112 @@
+/* Author: Jan Šulák
+ * Description: Append rate and query latency of the memory-mapped weather history, before and after the rings wrap around.
+ * Date: 9.December 2024
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+#include "weather_history.h"
+
+using namespace std;
+
+const size_t CITIES = 4;
+const size_t CAPACITY = 100000;
+const size_t WRAPPED = 250000; // Readings per city in the second round, 2.5 times the capacity
+const int QUERIES = 200;
+const size_t POINTS = 100;
+const long FIRST_ID = 3078610;
+
+static double elapsedMs(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Function to append readings [from, to) to every city, one per timestamp, returns false on a rejected one
+static bool fill(WeatherHistory &history, size_t from, size_t to)
+{
+    for (size_t i = from; i < to; ++i)
+    {
+        for (size_t city = 0; city < CITIES; ++city)
+        {
+            if (!history.append(FIRST_ID + static_cast<long>(city), static_cast<uint32_t>(i + 1),
+                                static_cast<int16_t>(i % 400) - 100, static_cast<uint8_t>(i % 100)))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Function to time queries of the window [from, to] and check the count of readings in it
+static bool measure(WeatherHistory &history, const char *label, uint32_t from, uint32_t to, uint32_t expected, double &checksum)
+{
+    WeatherHistory::Summary summary;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < QUERIES; ++i)
+    {
+        if (!history.query(FIRST_ID + i % static_cast<int>(CITIES), from, to, POINTS, summary))
+        {
+            cerr << label << ": the city has no history" << endl;
+            return false;
+        }
+        checksum += summary.temperatureAvg;
+    }
+    cout << label << ": " << elapsedMs(start) * 1e3 / QUERIES << " us/query of " << summary.count << " readings in "
+         << summary.series.size() << " points" << endl;
+    if (summary.count != expected || summary.series.size() != POINTS)
+    {
+        cerr << label << ": expected " << expected << " readings, got " << summary.count << endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    char path[] = "/tmp/weather_history_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        cerr << "Failed to create the history file" << endl;
+        return 1;
+    }
+    close(fd);
+
+    bool ok = true;
+    double checksum = 0;
+    {
+        WeatherHistory history(CITIES, CAPACITY);
+        if (!history.open(path))
+        {
+            remove(path);
+            return 1;
+        }
+
+        // The first round fills the rings exactly, the second one overwrites them one and a half times more
+        auto start = chrono::steady_clock::now();
+        ok = fill(history, 0, CAPACITY);
+        cout << "append: " << elapsedMs(start) * 1e6 / (CAPACITY * CITIES) << " ns/reading" << endl;
+        const uint32_t last = static_cast<uint32_t>(CAPACITY);
+        ok = ok && measure(history, "full ring", 1, last, last, checksum);
+        ok = ok && measure(history, "last tenth", last - last / 10 + 1, last, last / 10, checksum);
+
+        ok = ok && fill(history, CAPACITY, WRAPPED);
+        const uint32_t newest = static_cast<uint32_t>(WRAPPED);
+        const uint32_t oldest = newest - last + 1;
+        ok = ok && measure(history, "wrapped ring", 0, newest, last, checksum);
+        ok = ok && measure(history, "wrapped, overwritten part", 1, oldest - 1, 0, checksum);
+        ok = ok && measure(history, "wrapped, around the oldest", oldest - 1000, oldest + 999, 1000, checksum);
+        const uint32_t seam = static_cast<uint32_t>(WRAPPED - WRAPPED % CAPACITY); // Last reading before index 0
+        ok = ok && measure(history, "wrapped, across the seam", seam - 499, seam + 500, 1000, checksum);
+        ok = ok && measure(history, "wrapped, last tenth", newest - last / 10 + 1, newest, last / 10, checksum);
+    }
+    cout << "checksum: " << checksum << endl;
+
+    remove(path);
+    return ok ? 0 : 1;
+}
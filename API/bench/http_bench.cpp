@@ -0,0 +1,110 @@
+/* Author: Jan Šulák
+ * Description: Benchmark of the keep-alive HTTP engine against a fresh cURL handle per request, using a local stand-in server.
+ * Date: 9.December 2024
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "http_engine.h"
+#include "mock_http_server.h"
+
+using namespace std;
+
+const int REQUESTS = 2000;
+const int CONCURRENCY = 32;
+
+// Function to handle HTTP response
+static size_t WriteCallback(void *contents, size_t size, size_t nmemb, string *out)
+{
+    size_t totalSize = size * nmemb;
+    out->append((char *)contents, totalSize);
+    return totalSize;
+}
+
+// Function to fetch the URL the way the service did before the engine, with a new handle per request
+static string fetchWithNewHandle(const string &url)
+{
+    CURL *curl = curl_easy_init();
+    string response;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    return response;
+}
+
+// Function to print one result line
+static void report(const string &name, chrono::steady_clock::duration elapsed, uint64_t connections)
+{
+    double seconds = chrono::duration<double>(elapsed).count();
+    cout << name << ": " << REQUESTS << " requests in " << seconds * 1000.0 << " ms, "
+         << seconds * 1e6 / REQUESTS << " us/request, "
+         << connections << " connections" << endl;
+}
+
+int main()
+{
+    ifstream file("bench/data/weather_brno.json");
+    stringstream recorded;
+    recorded << file.rdbuf();
+    const string body = recorded.str();
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    {
+        MockHttpServer server([&body](const string &)
+                              { return MockResponse{200, body}; });
+        const string url = server.baseUrl() + "/data/2.5/weather?q=Brno&units=metric";
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < REQUESTS; ++i)
+        {
+            fetchWithNewHandle(url);
+        }
+        report("new handle per request", chrono::steady_clock::now() - start, server.connections());
+    }
+
+    {
+        MockHttpServer server([&body](const string &)
+                              { return MockResponse{200, body}; });
+        const string url = server.baseUrl() + "/data/2.5/weather?q=Brno&units=metric";
+        HttpEngine http;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < REQUESTS; ++i)
+        {
+            http.fetch(url).get();
+        }
+        report("engine, sequential", chrono::steady_clock::now() - start, server.connections());
+    }
+
+    {
+        MockHttpServer server([&body](const string &)
+                              { return MockResponse{200, body}; });
+        const string url = server.baseUrl() + "/data/2.5/weather?q=Brno&units=metric";
+        HttpEngine http(CONCURRENCY);
+        auto start = chrono::steady_clock::now();
+        for (int done = 0; done < REQUESTS; done += CONCURRENCY)
+        {
+            vector<future<HttpResponse>> batch;
+            for (int i = 0; i < CONCURRENCY && done + i < REQUESTS; ++i)
+            {
+                batch.push_back(http.fetch(url));
+            }
+            for (future<HttpResponse> &response : batch)
+            {
+                response.get();
+            }
+        }
+        HttpEngine::Stats stats = http.stats();
+        report("engine, " + to_string(CONCURRENCY) + " concurrent", chrono::steady_clock::now() - start, server.connections());
+        cout << "engine reused a connection for " << stats.requests - stats.newConnections << " of " << stats.requests << " requests" << endl;
+    }
+
+    curl_global_cleanup();
+    return 0;
+}
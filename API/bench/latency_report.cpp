@@ -0,0 +1,100 @@
+/* Author: Jan Šulák
+ * Description: Latency samples with percentiles, written as machine-readable JSON by the load tools.
+ * Date: 9.December 2024
+ */
+
+#include "latency_report.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+void LatencyReport::add(double milliseconds)
+{
+    lock_guard<mutex> lock(reportMutex);
+    latencies.push_back(milliseconds);
+    sorted = false;
+}
+
+void LatencyReport::count(const string &counter, uint64_t amount)
+{
+    lock_guard<mutex> lock(reportMutex);
+    counters[counter] += amount;
+}
+
+void LatencyReport::set(const string &field, double value)
+{
+    lock_guard<mutex> lock(reportMutex);
+    fields[field] = value;
+}
+
+size_t LatencyReport::samples()
+{
+    lock_guard<mutex> lock(reportMutex);
+    return latencies.size();
+}
+
+double LatencyReport::percentile(double fraction)
+{
+    lock_guard<mutex> lock(reportMutex);
+    return percentileLocked(fraction);
+}
+
+// Nearest-rank percentile, must be called with reportMutex held
+double LatencyReport::percentileLocked(double fraction)
+{
+    if (latencies.empty())
+    {
+        return 0.0;
+    }
+    if (!sorted)
+    {
+        sort(latencies.begin(), latencies.end());
+        sorted = true;
+    }
+    size_t rank = static_cast<size_t>(ceil(fraction * latencies.size()));
+    return latencies[rank == 0 ? 0 : rank - 1];
+}
+
+void LatencyReport::writeJson(ostream &out)
+{
+    lock_guard<mutex> lock(reportMutex);
+    out << "{";
+    for (const auto &field : fields)
+    {
+        out << "\"" << field.first << "\": " << field.second << ", ";
+    }
+    out << "\"counters\": {";
+    bool first = true;
+    for (const auto &counter : counters)
+    {
+        out << (first ? "" : ", ") << "\"" << counter.first << "\": " << counter.second;
+        first = false;
+    }
+    double mean = latencies.empty() ? 0.0 : accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+    out << "}, \"latency_ms\": {"
+        << "\"samples\": " << latencies.size()
+        << ", \"mean\": " << mean
+        << ", \"p50\": " << percentileLocked(0.50)
+        << ", \"p95\": " << percentileLocked(0.95)
+        << ", \"p99\": " << percentileLocked(0.99)
+        << ", \"max\": " << percentileLocked(1.0)
+        << "}}" << endl;
+}
+
+void LatencyReport::print(ostream &out)
+{
+    lock_guard<mutex> lock(reportMutex);
+    for (const auto &field : fields)
+    {
+        out << field.first << ": " << field.second << endl;
+    }
+    for (const auto &counter : counters)
+    {
+        out << counter.first << ": " << counter.second << endl;
+    }
+    out << "latency p50/p95/p99/max: " << percentileLocked(0.50) << " / " << percentileLocked(0.95) << " / "
+        << percentileLocked(0.99) << " / " << percentileLocked(1.0) << " ms" << endl;
+}
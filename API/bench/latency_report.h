@@ -0,0 +1,40 @@
+/* Author: Jan Šulák
+ * Description: Latency samples with percentiles, written as machine-readable JSON by the load tools.
+ * Date: 9.December 2024
+ */
+
+#ifndef LATENCY_REPORT_H
+#define LATENCY_REPORT_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class LatencyReport
+{
+public:
+    void add(double milliseconds);
+    void count(const std::string &counter, uint64_t amount = 1);
+    void set(const std::string &field, double value);
+
+    size_t samples();
+    double percentile(double fraction); // fraction in [0, 1], 0 without samples
+
+    // Writes {"field": value, ..., "counters": {...}, "latency_ms": {"p50", "p95", "p99", "max", "mean"}}
+    void writeJson(std::ostream &out);
+    void print(std::ostream &out);
+
+private:
+    std::mutex reportMutex;
+    std::vector<double> latencies;
+    bool sorted = true;
+    std::map<std::string, uint64_t> counters;
+    std::map<std::string, double> fields;
+
+    double percentileLocked(double fraction);
+};
+
+#endif // LATENCY_REPORT_H
@@ -0,0 +1,177 @@
+/* Author: Jan Šulák
+ * Description: Minimal local HTTP/1.1 server with keep-alive, standing in for the OpenWeather API in benchmarks.
+ * Date: 9.December 2024
+ */
+
+#include "mock_http_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Function to map the status code to its reason phrase
+static const char *reasonPhrase(int status)
+{
+    switch (status)
+    {
+    case 200:
+        return "OK";
+    case 404:
+        return "Not Found";
+    case 429:
+        return "Too Many Requests";
+    case 500:
+        return "Internal Server Error";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Unknown";
+    }
+}
+
+// Function to write the whole buffer to the socket
+static bool sendAll(int fd, const string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+MockHttpServer::MockHttpServer(Handler handler, uint16_t port) : handler(move(handler))
+{
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0)
+    {
+        throw runtime_error("Failed to create the listening socket");
+    }
+    int yes = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listenFd, 128) < 0)
+    {
+        close(listenFd);
+        throw runtime_error("Failed to bind the mock HTTP server to port " + to_string(port));
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &len);
+    boundPort = ntohs(addr.sin_port);
+
+    acceptThread = thread(&MockHttpServer::acceptLoop, this);
+}
+
+MockHttpServer::~MockHttpServer()
+{
+    stop();
+}
+
+void MockHttpServer::stop()
+{
+    if (stopping.exchange(true))
+    {
+        return;
+    }
+    shutdown(listenFd, SHUT_RDWR);
+    close(listenFd);
+    acceptThread.join();
+
+    vector<thread> threads;
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        for (int fd : openFds)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+        threads.swap(connectionThreads);
+    }
+    for (thread &connection : threads)
+    {
+        connection.join();
+    }
+}
+
+void MockHttpServer::acceptLoop()
+{
+    while (!stopping)
+    {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            continue;
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        acceptedConnections++;
+
+        lock_guard<mutex> lock(connectionsMutex);
+        if (stopping)
+        {
+            close(fd);
+            break;
+        }
+        openFds.insert(fd);
+        connectionThreads.emplace_back(&MockHttpServer::serveConnection, this, fd);
+    }
+}
+
+// Function to answer the requests of one keep-alive connection until the client closes it
+void MockHttpServer::serveConnection(int fd)
+{
+    string buffer;
+    char chunk[4096];
+    bool open = true;
+    while (open && !stopping)
+    {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd == string::npos)
+        {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+            {
+                break;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+            continue;
+        }
+
+        // Request line: METHOD SP target SP version, request bodies are not expected
+        string head = buffer.substr(0, headerEnd);
+        buffer.erase(0, headerEnd + 4);
+        size_t targetStart = head.find(' ');
+        size_t targetEnd = head.find(' ', targetStart + 1);
+        string target = targetStart != string::npos && targetEnd != string::npos
+                            ? head.substr(targetStart + 1, targetEnd - targetStart - 1)
+                            : "/";
+        bool closeRequested = head.find("Connection: close") != string::npos;
+
+        MockResponse response = handler(target);
+        servedRequests++;
+        string reply = "HTTP/1.1 " + to_string(response.status) + " " + reasonPhrase(response.status) + "\r\n" +
+                       "Content-Type: application/json\r\n" +
+                       "Content-Length: " + to_string(response.body.size()) + "\r\n" +
+                       (closeRequested ? "Connection: close\r\n" : "Connection: keep-alive\r\n") +
+                       "\r\n" + response.body;
+        open = sendAll(fd, reply) && !closeRequested;
+    }
+
+    lock_guard<mutex> lock(connectionsMutex);
+    openFds.erase(fd);
+    close(fd);
+}
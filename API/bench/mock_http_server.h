@@ -0,0 +1,62 @@
+/* Author: Jan Šulák
+ * Description: Minimal local HTTP/1.1 server with keep-alive, standing in for the OpenWeather API in benchmarks.
+ * Date: 9.December 2024
+ */
+
+#ifndef MOCK_HTTP_SERVER_H
+#define MOCK_HTTP_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct MockResponse
+{
+    int status = 200;
+    std::string body;
+};
+
+class MockHttpServer
+{
+public:
+    // Produces the response for the request target, e.g. "/data/2.5/weather?q=Brno"
+    using Handler = std::function<MockResponse(const std::string &)>;
+
+    explicit MockHttpServer(Handler handler, uint16_t port = 0);
+    ~MockHttpServer();
+
+    MockHttpServer(const MockHttpServer &) = delete;
+    MockHttpServer &operator=(const MockHttpServer &) = delete;
+
+    uint16_t port() const { return boundPort; }
+    std::string baseUrl() const { return "http://127.0.0.1:" + std::to_string(boundPort); }
+
+    void stop();
+
+    uint64_t connections() const { return acceptedConnections.load(); }
+    uint64_t requests() const { return servedRequests.load(); }
+
+private:
+    void acceptLoop();
+    void serveConnection(int fd);
+
+    const Handler handler;
+    int listenFd = -1;
+    uint16_t boundPort = 0;
+    std::atomic<bool> stopping{false};
+    std::thread acceptThread;
+
+    std::mutex connectionsMutex;
+    std::set<int> openFds;
+    std::vector<std::thread> connectionThreads;
+
+    std::atomic<uint64_t> acceptedConnections{0};
+    std::atomic<uint64_t> servedRequests{0};
+};
+
+#endif // MOCK_HTTP_SERVER_H
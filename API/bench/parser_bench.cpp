@@ -0,0 +1,94 @@
+/* Author: Jan Šulák
+ * Description: Microbenchmark of the single-pass weather parser against the original find/substr/istringstream parser.
+ * Date: 9.December 2024
+ */
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "weather_parser.h"
+
+using namespace std;
+
+const int ITERATIONS = 200000;
+const vector<string> RECORDED = {"bench/data/weather_brno.json", "bench/data/weather_london.json"};
+
+// Original parser of the service, kept here as the baseline
+static void legacyParseWeatherData(const string &jsonResponse, int &temperature, int &humidity)
+{
+    size_t tempPos = jsonResponse.find("\"temp\":");
+    if (tempPos != string::npos)
+    {
+        istringstream tempStream(jsonResponse.substr(tempPos + 7));
+        tempStream >> temperature;
+    }
+
+    size_t humidityPos = jsonResponse.find("\"humidity\":");
+    if (humidityPos != string::npos)
+    {
+        istringstream humidityStream(jsonResponse.substr(humidityPos + 11));
+        humidityStream >> humidity;
+    }
+}
+
+int main()
+{
+    vector<string> responses;
+    for (const string &path : RECORDED)
+    {
+        ifstream file(path);
+        if (!file.is_open())
+        {
+            cerr << "Failed to open recorded response: " << path << endl;
+            return 1;
+        }
+        stringstream content;
+        content << file.rdbuf();
+        responses.push_back(content.str());
+    }
+
+    // Both parsers have to agree before their speed is worth comparing
+    for (const string &response : responses)
+    {
+        int temperature = 0;
+        int humidity = 0;
+        legacyParseWeatherData(response, temperature, humidity);
+        WeatherReading reading;
+        if (parseWeather(response, reading) != ParseStatus::OK || reading.humidity != humidity ||
+            static_cast<int>(reading.temperature) != temperature)
+        {
+            cerr << "Parsers disagree on: " << response << endl;
+            return 1;
+        }
+    }
+
+    long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        int temperature = 0;
+        int humidity = 0;
+        legacyParseWeatherData(responses[i % responses.size()], temperature, humidity);
+        checksum += temperature + humidity;
+    }
+    double legacy = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        WeatherReading reading;
+        parseWeather(responses[i % responses.size()], reading);
+        checksum += lround(reading.temperature) + reading.humidity;
+    }
+    double singlePass = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    cout << "legacy parser: " << legacy << " ns/response (temperature and humidity only)" << endl;
+    cout << "single-pass parser: " << singlePass << " ns/response (all fields, validated)" << endl;
+    cout << "checksum: " << checksum << endl;
+    return 0;
+}
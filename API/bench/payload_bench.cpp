@@ -0,0 +1,137 @@
+/* Author: Jan Šulák
+ * Description: Round-trip check and benchmark of the binary weather payload against the JSON payload parsed the way the display does.
+ * Date: 9.December 2024
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "weather_payload.h"
+
+using namespace std;
+
+const int ITERATIONS = 1000000;
+
+// JSON payload as built by publishWeather()
+static string encodeJson(int temperature, int humidity, const string &mood)
+{
+    return "{ \"temperature\": " + to_string(temperature) +
+           ", \"humidity\": " + to_string(humidity) +
+           ", \"mood\": \"" + mood + "\" }";
+}
+
+// Character walk of parseMessage() in GestureWeather/src/screen.cpp, including its string building
+static void decodeJson(const string &message, string &temperature, string &humidity, string &mood)
+{
+    string temp, hum, md;
+    size_t i = 0;
+    while (message[i] != ':')
+        i++;
+    i += 2;
+    while (message[i] != ',')
+        temp += message[i++];
+    i += 2;
+    while (message[i] != ':')
+        i++;
+    i += 2;
+    while (message[i] != ',')
+        hum += message[i++];
+    i += 2;
+    while (message[i] != ':')
+        i++;
+    i += 3;
+    while (message[i] != '"')
+        md += message[i++];
+    temperature = temp;
+    humidity = hum;
+    mood = md;
+}
+
+// Function to check that every value survives an encode/decode cycle and that bad input is rejected
+static bool roundTrip()
+{
+    uint8_t buffer[WEATHER_PAYLOAD_SIZE];
+    const uint32_t timestamps[] = {0u, 1733745600u, 0xFFFFFFFFu};
+    for (int temperature = -32768; temperature <= 32767; temperature += 7)
+    {
+        for (uint8_t mood = 0; mood < MOOD_COUNT; ++mood)
+        {
+            for (uint32_t timestamp : timestamps)
+            {
+                WeatherPayload in{static_cast<int16_t>(temperature), static_cast<uint8_t>(temperature & 0x7F), mood, timestamp};
+                WeatherPayload out{};
+                encodeWeatherPayload(in, buffer);
+                if (!decodeWeatherPayload(buffer, sizeof(buffer), out) || out.temperatureTenths != in.temperatureTenths ||
+                    out.humidity != in.humidity || out.mood != in.mood || out.timestamp != in.timestamp)
+                {
+                    cerr << "Round trip failed for temperature " << temperature << ", mood " << int(mood) << endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    WeatherPayload out{};
+    encodeWeatherPayload(WeatherPayload{215, 40, 1, 1733745600u}, buffer);
+    if (decodeWeatherPayload(buffer, WEATHER_PAYLOAD_SIZE - 1, out))
+    {
+        cerr << "Truncated payload was accepted" << endl;
+        return false;
+    }
+    buffer[0] = WEATHER_PAYLOAD_VERSION + 1;
+    if (decodeWeatherPayload(buffer, sizeof(buffer), out))
+    {
+        cerr << "Payload of an unknown version was accepted" << endl;
+        return false;
+    }
+    buffer[0] = WEATHER_PAYLOAD_VERSION;
+    buffer[1] = MOOD_COUNT;
+    if (decodeWeatherPayload(buffer, sizeof(buffer), out))
+    {
+        cerr << "Payload with an unknown mood was accepted" << endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!roundTrip())
+    {
+        return 1;
+    }
+    cout << "round trip: OK" << endl;
+
+    long checksum = 0;
+    size_t jsonBytes = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        string message = encodeJson(i % 40 - 10, i % 100, MOOD_NAMES[i % MOOD_COUNT]);
+        jsonBytes = message.size();
+        string temperature, humidity, mood;
+        decodeJson(message, temperature, humidity, mood);
+        checksum += stoi(temperature) + stoi(humidity) + static_cast<long>(mood.size());
+    }
+    double json = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        uint8_t buffer[WEATHER_PAYLOAD_SIZE];
+        WeatherPayload in{static_cast<int16_t>((i % 40 - 10) * 10), static_cast<uint8_t>(i % 100),
+                          static_cast<uint8_t>(i % MOOD_COUNT), static_cast<uint32_t>(i)};
+        encodeWeatherPayload(in, buffer);
+        WeatherPayload out{};
+        decodeWeatherPayload(buffer, sizeof(buffer), out);
+        checksum += out.temperatureTenths / 10 + out.humidity + out.mood;
+    }
+    double binary = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    cout << "json: " << jsonBytes << " bytes, " << json << " ns/encode+decode" << endl;
+    cout << "binary: " << WEATHER_PAYLOAD_SIZE << " bytes, " << binary << " ns/encode+decode" << endl;
+    cout << "checksum: " << checksum << endl;
+    return 0;
+}
@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# Author: Jan Šulák
+# Description: End-to-end load test of weather_mqtt against a local Mosquitto broker and the mock OpenWeather API.
+# Date: 9.December 2024
+#
+# Run from the API directory after building the service and the bench tools (make bench-load does both).
+# Every setting can be overridden from the environment, e.g. DISPLAYS=50 RATE=500 ./bench/run_load.sh
+# INSTANCES=3 starts three services splitting the requests through a shared subscription group.
+
+set -euo pipefail
+
+DISPLAYS=${DISPLAYS:-10}          # Simulated displays
+RATE=${RATE:-50}                  # Requests per second over all displays
+DURATION=${DURATION:-10}          # Seconds of load
+MOOD_SHARE=${MOOD_SHARE:-0.2}     # Fraction of requests changing the mood
+LATENCY_MS=${LATENCY_MS:-50}      # Mock upstream latency
+JITTER_MS=${JITTER_MS:-20}        # Mock upstream latency jitter
+ERROR_RATE=${ERROR_RATE:-0.0}     # Fraction of upstream calls failing with HTTP 500
+RATE_LIMIT=${RATE_LIMIT:-0}       # Upstream calls per minute the mock answers before HTTP 429, 0 for no limit
+UPSTREAM_RATE=${UPSTREAM_RATE:-0} # Upstream calls per minute the service allows itself, 0 for no limit
+BROKER_PORT=${BROKER_PORT:-18830}
+HTTP_PORT=${HTTP_PORT:-18080}
+INSTANCES=${INSTANCES:-1}         # Service instances in the shared subscription group
+OUTPUT=${OUTPUT:-bench_results.json}
+
+API_DIR=$(pwd)
+WORK_DIR=$(mktemp -d)
+PIDS=()
+
+cleanup()
+{
+    for pid in "${PIDS[@]}"; do
+        kill "$pid" 2>/dev/null || true
+    done
+    wait 2>/dev/null || true
+    rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+if ! command -v mosquitto >/dev/null; then
+    echo "mosquitto is required as the local broker" >&2
+    exit 1
+fi
+
+mosquitto -p "$BROKER_PORT" >"$WORK_DIR/broker.log" 2>&1 &
+PIDS+=($!)
+
+"$API_DIR/obj/tools/mock_openweather" --port "$HTTP_PORT" --latency-ms "$LATENCY_MS" \
+    --jitter-ms "$JITTER_MS" --error-rate "$ERROR_RATE" --rate-limit "$RATE_LIMIT" >"$WORK_DIR/mock.log" 2>&1 &
+PIDS+=($!)
+sleep 0.5
+
+# Each instance keeps data.txt and its other files in its own working directory
+for ((i = 1; i <= INSTANCES; i++)); do
+    mkdir -p "$WORK_DIR/api$i"
+    (
+        cd "$WORK_DIR/api$i"
+        WEATHER_MQTT_BROKER="tcp://127.0.0.1:$BROKER_PORT" \
+        WEATHER_API_URL="http://127.0.0.1:$HTTP_PORT/data/2.5" \
+        WEATHER_PREFETCH_INTERVAL=0 \
+        WEATHER_UPSTREAM_RATE="$UPSTREAM_RATE" \
+        WEATHER_SHARE_GROUP=weather \
+        WEATHER_INSTANCE_ID="api$i" \
+        exec "$API_DIR/weather_mqtt" >"$WORK_DIR/api$i/service.log" 2>&1
+    ) &
+    PIDS+=($!)
+done
+sleep 1
+
+"$API_DIR/obj/tools/load_generator" --broker "tcp://127.0.0.1:$BROKER_PORT" --displays "$DISPLAYS" \
+    --rate "$RATE" --duration "$DURATION" --mood-share "$MOOD_SHARE" --output "$API_DIR/$OUTPUT"
@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+# Author: Jan Šulák
+# Description: Replays a traffic trace recorded with WEATHER_TRACE_FILE against weather_mqtt and a local Mosquitto broker.
+# Date: 9.December 2024
+#
+# Run from the API directory after building the service and the bench tools (make bench-replay TRACE=... does both).
+# The upstream responses come from the trace, so the run does not need the OpenWeather API, e.g.
+# TRACE=traffic.trace SPEED=4 ./bench/run_replay.sh
+
+set -euo pipefail
+
+TRACE=${TRACE:?set TRACE to a trace file recorded with WEATHER_TRACE_FILE}
+SPEED=${SPEED:-1}                 # 1 as recorded, N times faster, 0 as fast as possible
+TIMEOUT_MS=${TIMEOUT_MS:-3000}    # Requests unanswered this long after the last one count as timed out
+BROKER_PORT=${BROKER_PORT:-18830}
+HTTP_PORT=${HTTP_PORT:-18080}
+OUTPUT=${OUTPUT:-replay_results.json}
+
+API_DIR=$(pwd)
+TRACE=$(realpath "$TRACE")
+WORK_DIR=$(mktemp -d)
+PIDS=()
+
+cleanup()
+{
+    for pid in "${PIDS[@]}"; do
+        kill "$pid" 2>/dev/null || true
+    done
+    wait 2>/dev/null || true
+    rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+if ! command -v mosquitto >/dev/null; then
+    echo "mosquitto is required as the local broker" >&2
+    exit 1
+fi
+
+mosquitto -p "$BROKER_PORT" >"$WORK_DIR/broker.log" 2>&1 &
+PIDS+=($!)
+sleep 0.5
+
+# Every request is answered with a republished snapshot so its latency can be measured,
+# and the limits of the real API do not apply to the recorded responses
+(
+    cd "$WORK_DIR"
+    WEATHER_MQTT_BROKER="tcp://127.0.0.1:$BROKER_PORT" \
+    WEATHER_API_URL="http://127.0.0.1:$HTTP_PORT/data/2.5" \
+    WEATHER_PREFETCH_INTERVAL=0 \
+    WEATHER_SNAPSHOT_TTL=0 \
+    WEATHER_UPSTREAM_RATE=0 \
+    exec "$API_DIR/weather_mqtt" >"$WORK_DIR/service.log" 2>&1
+) &
+PIDS+=($!)
+sleep 1
+
+"$API_DIR/obj/tools/replay_trace" --trace "$TRACE" --broker "tcp://127.0.0.1:$BROKER_PORT" --http-port "$HTTP_PORT" \
+    --speed "$SPEED" --timeout-ms "$TIMEOUT_MS" --output "$API_DIR/$OUTPUT"
@@ -0,0 +1,254 @@
+/* Author: Jan Šulák
+ * Description: Simulated displays reading cities and changing moods at a target rate, measuring request-to-reply latency.
+ * Date: 9.December 2024
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mqtt/async_client.h>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency_report.h"
+#include "weather_tables.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+const vector<string> CITIES(FEATURED_CITY_NAMES, FEATURED_CITY_NAMES + FEATURED_CITY_COUNT);
+const vector<string> MOODS(MOOD_NAMES, MOOD_NAMES + MOOD_COUNT);
+
+struct Options
+{
+    string broker = "tcp://127.0.0.1:18830";
+    int displays = 10;
+    double rate = 50.0;      // Requests per second over all displays
+    int duration = 10;       // Seconds
+    double moodShare = 0.2;  // Fraction of requests that also change the mood
+    int timeoutMs = 3000;    // The display gives up after 3 s as well
+    int fallbackMs = 500;    // Reads without a retained snapshot send a request after this long, like the firmware
+    string output = "bench_results.json";
+};
+
+// One display: like the firmware, it subscribes to the city topic for every read and takes the retained
+// snapshot, a mood change is a request answered by the republished snapshot carrying the new mood
+class SimulatedDisplay : public virtual mqtt::callback
+{
+public:
+    SimulatedDisplay(const Options &options, int index, LatencyReport &report)
+        : options(options), report(report), client(options.broker, "loadgen-" + to_string(index)),
+          random(static_cast<unsigned>(index) * 7919u + 1u)
+    {
+        client.set_callback(*this);
+    }
+
+    void connect()
+    {
+        mqtt::connect_options connOpts;
+        connOpts.set_clean_session(true);
+        client.connect(connOpts)->wait();
+    }
+
+    void disconnect()
+    {
+        if (client.is_connected())
+        {
+            client.disconnect()->wait();
+        }
+    }
+
+    void message_arrived(mqtt::const_message_ptr msg) override
+    {
+        lock_guard<mutex> lock(replyMutex);
+        if (waiting && msg->get_topic() == waitingCity &&
+            (waitingMood.empty() || msg->get_payload().find("\"mood\": \"" + waitingMood + "\"") != string::npos))
+        {
+            waiting = false;
+            replyAt = Clock::now();
+            replySignal.notify_one();
+        }
+    }
+
+    // Sends requests paced to the per-display rate until the deadline
+    void run(Clock::time_point start, Clock::time_point deadline)
+    {
+        auto interval = chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.displays / options.rate));
+        Clock::time_point next = start;
+        while (next < deadline)
+        {
+            this_thread::sleep_until(next);
+            next += interval;
+
+            string city = CITIES[uniform_int_distribution<size_t>(0, CITIES.size() - 1)(random)];
+            string mood;
+            if (uniform_real_distribution<double>(0.0, 1.0)(random) < options.moodShare)
+            {
+                mood = MOODS[uniform_int_distribution<size_t>(0, MOODS.size() - 1)(random)];
+            }
+
+            unique_lock<mutex> lock(replyMutex);
+            waiting = true;
+            waitingCity = city;
+            waitingMood = mood;
+            Clock::time_point sentAt = Clock::now();
+            lock.unlock();
+            bool replied = false;
+            try
+            {
+                client.subscribe(city, 1);
+                if (!mood.empty())
+                {
+                    publishRequest(city + " " + mood);
+                    report.count("mood_changes");
+                }
+                else
+                {
+                    report.count("reads");
+                }
+
+                lock.lock();
+                replied = replySignal.wait_for(lock, chrono::milliseconds(options.fallbackMs), [this]
+                                               { return !waiting; });
+                if (!replied && mood.empty())
+                { // Nothing retained yet, ask the service to fetch the city
+                    lock.unlock();
+                    publishRequest(city);
+                    report.count("fallback_requests");
+                    lock.lock();
+                }
+                replied = replied || replySignal.wait_for(lock, chrono::milliseconds(options.timeoutMs - options.fallbackMs), [this]
+                                                          { return !waiting; });
+                waiting = false;
+                lock.unlock();
+                client.unsubscribe(city);
+            }
+            catch (const mqtt::exception &e)
+            {
+                report.count("mqtt_errors");
+                continue;
+            }
+
+            if (replied)
+            {
+                report.add(chrono::duration<double, milli>(replyAt - sentAt).count());
+                report.count("replies");
+            }
+            else
+            {
+                report.count("timeouts");
+            }
+        }
+    }
+
+private:
+    void publishRequest(const string &payload)
+    {
+        client.publish("requests", payload.data(), payload.size(), 1, false);
+        report.count("requests");
+    }
+
+    const Options &options;
+    LatencyReport &report;
+    mqtt::async_client client;
+    mt19937 random;
+
+    mutex replyMutex;
+    condition_variable replySignal;
+    bool waiting = false;
+    string waitingCity;
+    string waitingMood; // Empty for reads, otherwise the reply has to carry this mood
+    Clock::time_point replyAt;
+};
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string name = argv[i];
+        if (name == "--broker")
+            options.broker = argv[i + 1];
+        else if (name == "--displays")
+            options.displays = max(1, atoi(argv[i + 1]));
+        else if (name == "--rate")
+            options.rate = atof(argv[i + 1]);
+        else if (name == "--duration")
+            options.duration = atoi(argv[i + 1]);
+        else if (name == "--mood-share")
+            options.moodShare = atof(argv[i + 1]);
+        else if (name == "--timeout-ms")
+            options.timeoutMs = atoi(argv[i + 1]);
+        else if (name == "--fallback-ms")
+            options.fallbackMs = atoi(argv[i + 1]);
+        else if (name == "--output")
+            options.output = argv[i + 1];
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--broker URI] [--displays N] [--rate R] [--duration S]"
+                 << " [--mood-share F] [--timeout-ms N] [--fallback-ms N] [--output FILE]" << endl;
+            return 1;
+        }
+    }
+    if (options.rate <= 0.0)
+    {
+        cerr << "The rate has to be positive" << endl;
+        return 1;
+    }
+
+    LatencyReport report;
+    vector<unique_ptr<SimulatedDisplay>> displays;
+    try
+    {
+        for (int i = 0; i < options.displays; ++i)
+        {
+            displays.push_back(make_unique<SimulatedDisplay>(options, i, report));
+            displays.back()->connect();
+        }
+    }
+    catch (const mqtt::exception &e)
+    {
+        cerr << "MQTT error: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Running " << options.displays << " displays at " << options.rate << " requests/s for "
+         << options.duration << " s against " << options.broker << endl;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + chrono::seconds(options.duration);
+    vector<thread> threads;
+    for (int i = 0; i < options.displays; ++i)
+    {
+        // Spread the displays over one interval so they do not send in lockstep
+        Clock::time_point offset = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / options.rate * i));
+        threads.emplace_back(&SimulatedDisplay::run, displays[i].get(), offset, deadline);
+    }
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+    for (auto &display : displays)
+    {
+        display->disconnect();
+    }
+
+    report.set("displays", options.displays);
+    report.set("target_rate", options.rate);
+    report.set("elapsed_s", elapsed);
+    report.set("throughput_rps", report.samples() / elapsed);
+    report.print(cout);
+
+    ofstream file(options.output);
+    report.writeJson(file);
+    cout << "Results written to " << options.output << endl;
+    return 0;
+}
@@ -0,0 +1,177 @@
+/* Author: Jan Šulák
+ * Description: Mock OpenWeather API with configurable latency, error rate and rate limit for load tests of the service.
+ * Date: 9.December 2024
+ */
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "mock_http_server.h"
+
+using namespace std;
+
+atomic<bool> running{true};
+
+struct Options
+{
+    uint16_t port = 18080;
+    int latencyMs = 50;     // Added to every response
+    int jitterMs = 0;       // Uniformly distributed extra latency
+    double errorRate = 0.0; // Fraction of requests answered with HTTP 500
+    int rateLimit = 0;      // Calls per minute answered before HTTP 429, like the quota of an API key, 0 for no limit
+};
+
+void signalHandler(int)
+{
+    running = false;
+}
+
+// Function to read the value of a query parameter from the request target
+static string queryParameter(const string &target, const string &name)
+{
+    size_t pos = target.find("?" + name + "=");
+    if (pos == string::npos)
+    {
+        pos = target.find("&" + name + "=");
+    }
+    if (pos == string::npos)
+    {
+        return "";
+    }
+    pos += name.size() + 2;
+    return target.substr(pos, target.find('&', pos) - pos);
+}
+
+// Function to build a current weather object shaped like the real API response
+static string weatherObject(long id, const string &name, double temperature, int humidity)
+{
+    return "{\"coord\":{\"lon\":16.6068,\"lat\":49.1952},"
+           "\"weather\":[{\"id\":803,\"main\":\"Clouds\",\"description\":\"broken clouds\",\"icon\":\"04d\"}],"
+           "\"base\":\"stations\",\"main\":{\"temp\":" +
+           to_string(temperature) + ",\"feels_like\":" + to_string(temperature - 3.0) +
+           ",\"temp_min\":" + to_string(temperature - 1.0) + ",\"temp_max\":" + to_string(temperature + 1.0) +
+           ",\"pressure\":1021,\"humidity\":" + to_string(humidity) +
+           "},\"visibility\":10000,\"wind\":{\"speed\":3.6,\"deg\":300},\"clouds\":{\"all\":75},\"dt\":" +
+           to_string(time(nullptr)) + ",\"sys\":{\"type\":2,\"id\":2093286,\"country\":\"CZ\"},"
+           "\"timezone\":3600,\"id\":" + to_string(id) + ",\"name\":\"" + name + "\",\"cod\":200}";
+}
+
+static long nameToId(const string &name)
+{
+    return static_cast<long>(hash<string>()(name) % 10000000);
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string name = argv[i];
+        if (name == "--port")
+            options.port = static_cast<uint16_t>(atoi(argv[i + 1]));
+        else if (name == "--latency-ms")
+            options.latencyMs = atoi(argv[i + 1]);
+        else if (name == "--jitter-ms")
+            options.jitterMs = atoi(argv[i + 1]);
+        else if (name == "--error-rate")
+            options.errorRate = atof(argv[i + 1]);
+        else if (name == "--rate-limit")
+            options.rateLimit = atoi(argv[i + 1]);
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--port N] [--latency-ms N] [--jitter-ms N] [--error-rate F] [--rate-limit N]" << endl;
+            return 1;
+        }
+    }
+
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    mutex randomMutex;
+    mt19937 random(random_device{}());
+    // Calls counted per whole minute, as the quota of the real API
+    mutex quotaMutex;
+    long quotaMinute = -1;
+    int quotaCalls = 0;
+    atomic<long> limited{0};
+
+    MockHttpServer server([&](const string &target)
+                          {
+        double roll;
+        int jitter;
+        {
+            lock_guard<mutex> lock(randomMutex);
+            roll = uniform_real_distribution<double>(0.0, 1.0)(random);
+            jitter = options.jitterMs > 0 ? uniform_int_distribution<int>(0, options.jitterMs)(random) : 0;
+        }
+        this_thread::sleep_for(chrono::milliseconds(options.latencyMs + jitter));
+
+        if (options.rateLimit > 0)
+        {
+            lock_guard<mutex> lock(quotaMutex);
+            long minute = static_cast<long>(time(nullptr) / 60);
+            if (minute != quotaMinute)
+            {
+                quotaMinute = minute;
+                quotaCalls = 0;
+            }
+            if (++quotaCalls > options.rateLimit)
+            {
+                limited++;
+                return MockResponse{429, "{\"cod\":429,\"message\":\"Your account is temporary blocked due to exceeding of requests limitation of your subscription type.\"}"};
+            }
+        }
+
+        if (roll < options.errorRate)
+        {
+            return MockResponse{500, "{\"cod\":500,\"message\":\"mock error\"}"};
+        }
+        if (target.find("/weather?") != string::npos)
+        {
+            string city = queryParameter(target, "q");
+            long id = city.empty() ? atol(queryParameter(target, "id").c_str()) : nameToId(city);
+            if (city.empty())
+            {
+                city = "City" + to_string(id);
+            }
+            return MockResponse{200, weatherObject(id, city, static_cast<double>(id % 300) / 10.0, static_cast<int>(id % 100))};
+        }
+        if (target.find("/group?") != string::npos)
+        {
+            string ids = queryParameter(target, "id");
+            string list;
+            int count = 0;
+            for (size_t start = 0; start < ids.size();)
+            {
+                size_t end = ids.find(',', start);
+                if (end == string::npos || end > ids.size())
+                {
+                    end = ids.size();
+                }
+                long id = atol(ids.substr(start, end - start).c_str());
+                list += (count++ ? "," : "") + weatherObject(id, "City" + to_string(id), static_cast<double>(id % 300) / 10.0, static_cast<int>(id % 100));
+                start = end + 1;
+            }
+            return MockResponse{200, "{\"cnt\":" + to_string(count) + ",\"list\":[" + list + "]}"};
+        }
+        return MockResponse{404, "{\"cod\":\"404\",\"message\":\"city not found\"}"}; },
+                          options.port);
+
+    cout << "Mock OpenWeather API listening on " << server.baseUrl() << "/data/2.5" << endl;
+    while (running)
+    {
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    server.stop();
+    cout << "Served " << server.requests() << " requests over " << server.connections() << " connections, "
+         << limited.load() << " over the rate limit" << endl;
+    return 0;
+}
@@ -0,0 +1,251 @@
+/* Author: Jan Šulák
+ * Description: Replays a recorded traffic trace against the service, serving the recorded upstream responses, and reports latency and throughput.
+ * Date: 9.December 2024
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mqtt/async_client.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency_report.h"
+#include "mock_http_server.h"
+#include "traffic_trace.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+const string REQUEST_TOPIC = "requests";
+const size_t PUBLISH_WINDOW = 256; // Publishes not yet acknowledged by the broker at maximum speed
+
+struct Options
+{
+    string trace;
+    string broker = "tcp://127.0.0.1:18830";
+    uint16_t httpPort = 18080;
+    double speed = 1.0;   // 2 replays twice as fast as recorded, 0 as fast as possible
+    int timeoutMs = 3000; // A request without a reply after this long counts as timed out
+    string output = "replay_results.json";
+};
+
+// Recorded upstream responses by request key, served in the recorded order and from the start again when used up
+class ResponseBook
+{
+public:
+    void add(const TraceRecord &record)
+    {
+        responses[record.key].push_back(MockResponse{record.status, record.body});
+    }
+
+    MockResponse serve(const string &target)
+    {
+        lock_guard<mutex> lock(bookMutex);
+        auto found = responses.find(traceRequestKey(target));
+        if (found == responses.end())
+        {
+            misses++;
+            return MockResponse{404, "{\"cod\":\"404\",\"message\":\"not in the trace\"}"};
+        }
+        size_t &cursor = cursors[found->first];
+        return found->second[cursor++ % found->second.size()];
+    }
+
+    size_t keys() const { return responses.size(); }
+    uint64_t unknown() const { return misses; }
+
+private:
+    mutex bookMutex;
+    map<string, vector<MockResponse>> responses;
+    map<string, size_t> cursors;
+    uint64_t misses = 0;
+};
+
+// Matches the weather replies on the city topics to the requests sent for the city. A reply answers every
+// request of the city sent before it, the service coalesces the updates of one topic.
+class ReplyTracker : public virtual mqtt::callback
+{
+public:
+    explicit ReplyTracker(LatencyReport &report) : report(report) {}
+
+    void sent(const string &city)
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        pending[city].push_back(Clock::now());
+    }
+
+    void message_arrived(mqtt::const_message_ptr msg) override
+    {
+        Clock::time_point now = Clock::now();
+        lock_guard<mutex> lock(pendingMutex);
+        auto found = pending.find(msg->get_topic());
+        if (found == pending.end())
+        {
+            return;
+        }
+        for (Clock::time_point sentAt : found->second)
+        {
+            report.add(chrono::duration<double, milli>(now - sentAt).count());
+        }
+        report.count("replies");
+        found->second.clear();
+    }
+
+    // Waits until every request is answered or the timeout passed since the last one was sent, returns the unanswered
+    size_t drain(chrono::milliseconds timeout)
+    {
+        Clock::time_point deadline = Clock::now() + timeout;
+        size_t outstanding = 0;
+        do
+        {
+            this_thread::sleep_for(chrono::milliseconds(10));
+            lock_guard<mutex> lock(pendingMutex);
+            outstanding = 0;
+            for (const auto &city : pending)
+            {
+                outstanding += city.second.size();
+            }
+        } while (outstanding > 0 && Clock::now() < deadline);
+        return outstanding;
+    }
+
+private:
+    LatencyReport &report;
+    mutex pendingMutex;
+    map<string, vector<Clock::time_point>> pending;
+};
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string name = argv[i];
+        if (name == "--trace")
+            options.trace = argv[i + 1];
+        else if (name == "--broker")
+            options.broker = argv[i + 1];
+        else if (name == "--http-port")
+            options.httpPort = static_cast<uint16_t>(atoi(argv[i + 1]));
+        else if (name == "--speed")
+            options.speed = atof(argv[i + 1]);
+        else if (name == "--timeout-ms")
+            options.timeoutMs = atoi(argv[i + 1]);
+        else if (name == "--output")
+            options.output = argv[i + 1];
+        else
+        {
+            options.trace.clear();
+            break;
+        }
+    }
+    if (options.trace.empty() || options.speed < 0.0)
+    {
+        cerr << "Usage: " << argv[0] << " --trace FILE [--broker URI] [--http-port N] [--speed X, 0 for maximum]"
+             << " [--timeout-ms N] [--output FILE]" << endl;
+        return 1;
+    }
+
+    TraceReader reader;
+    if (!reader.open(options.trace))
+    {
+        return 1;
+    }
+    ResponseBook book;
+    vector<TraceRecord> messages;
+    TraceRecord record;
+    while (reader.next(record))
+    {
+        if (record.kind == TraceRecord::RESPONSE)
+        {
+            book.add(record);
+        }
+        else if (record.kind == TraceRecord::MESSAGE)
+        {
+            messages.push_back(record);
+        }
+    }
+    if (messages.empty())
+    {
+        cerr << "The trace holds no messages" << endl;
+        return 1;
+    }
+    double traceSeconds = (messages.back().micros - messages.front().micros) / 1e6;
+    cout << "Loaded " << messages.size() << " messages over " << traceSeconds << " s and responses for "
+         << book.keys() << " upstream requests" << endl;
+
+    MockHttpServer server([&book](const string &target)
+                          { return book.serve(target); },
+                          options.httpPort);
+
+    LatencyReport report;
+    ReplyTracker tracker(report);
+    mqtt::async_client client(options.broker, "replay-trace");
+    client.set_callback(tracker);
+    try
+    {
+        mqtt::connect_options connOpts;
+        connOpts.set_clean_session(true);
+        client.connect(connOpts)->wait();
+        client.subscribe("+", 0)->wait(); // The JSON replies on the city topics
+    }
+    catch (const mqtt::exception &e)
+    {
+        cerr << "MQTT error: " << e.what() << endl;
+        return 1;
+    }
+
+    Clock::time_point start = Clock::now();
+    deque<mqtt::delivery_token_ptr> window;
+    for (const TraceRecord &message : messages)
+    {
+        if (options.speed > 0.0)
+        {
+            double offset = (message.micros - messages.front().micros) / 1e6 / options.speed;
+            this_thread::sleep_until(start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(offset)));
+        }
+        if (message.key == REQUEST_TOPIC && !message.body.empty())
+        {
+            tracker.sent(message.body.substr(0, message.body.find(' ')));
+        }
+        report.count("messages");
+        try
+        {
+            window.push_back(client.publish(message.key, message.body.data(), message.body.size(), 1, false));
+            if (window.size() >= PUBLISH_WINDOW)
+            {
+                window.front()->wait();
+                window.pop_front();
+            }
+        }
+        catch (const mqtt::exception &)
+        {
+            report.count("mqtt_errors");
+        }
+    }
+    double sendSeconds = chrono::duration<double>(Clock::now() - start).count();
+    size_t unanswered = tracker.drain(chrono::milliseconds(options.timeoutMs));
+    double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+    client.disconnect()->wait();
+    server.stop();
+
+    report.count("timeouts", unanswered);
+    report.count("unknown_upstream_requests", book.unknown());
+    report.set("speed", options.speed);
+    report.set("trace_s", traceSeconds);
+    report.set("send_s", sendSeconds);
+    report.set("elapsed_s", elapsed);
+    report.set("throughput_rps", messages.size() / sendSeconds);
+    report.print(cout);
+    ofstream file(options.output);
+    report.writeJson(file);
+    cout << "Results written to " << options.output << endl;
+    return 0;
+}
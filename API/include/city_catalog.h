@@ -0,0 +1,55 @@
+/* Author: Jan Šulák
+ * Description: Read-only city catalog memory-mapped from a tab-separated file of OpenWeather cities.
+ * Date: 9.December 2024
+ */
+
+#ifndef CITY_CATALOG_H
+#define CITY_CATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One line per city: "id<TAB>name<TAB>country<TAB>latitude<TAB>longitude", lines starting with # are comments.
+// Names stay in the mapped file, each record only keeps their offset. A name becomes an MQTT topic, lines
+// with '/', '+', '#' or control characters in it are skipped as malformed.
+class CityCatalog
+{
+public:
+    CityCatalog() = default;
+    ~CityCatalog();
+
+    CityCatalog(const CityCatalog &) = delete;
+    CityCatalog &operator=(const CityCatalog &) = delete;
+
+    // Maps the file and indexes its lines, returns false if it cannot be read, malformed lines are skipped
+    bool load(const std::string &path);
+
+    size_t size() const { return records.size(); }
+    std::string_view name(size_t i) const { return std::string_view(data + records[i].nameOffset, records[i].nameLength); }
+    long weatherId(size_t i) const { return records[i].weatherId; }
+    std::string_view country(size_t i) const { return std::string_view(records[i].country, records[i].country[1] ? 2 : (records[i].country[0] ? 1 : 0)); }
+    float latitude(size_t i) const { return records[i].latitude; }
+    float longitude(size_t i) const { return records[i].longitude; }
+
+private:
+    struct Record
+    {
+        uint32_t nameOffset;
+        uint16_t nameLength;
+        char country[2];
+        uint32_t weatherId;
+        float latitude;
+        float longitude;
+    };
+
+    bool parseLine(std::string_view line, size_t offset);
+
+    const char *data = nullptr;
+    size_t length = 0;
+    std::vector<Record> records;
+};
+
+#endif // CITY_CATALOG_H
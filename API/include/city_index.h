@@ -0,0 +1,51 @@
+/* Author: Jan Šulák
+ * Description: Prefix and trigram search over the city names of the registry.
+ * Date: 9.December 2024
+ */
+
+#ifndef CITY_INDEX_H
+#define CITY_INDEX_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "city_registry.h"
+
+// Matching ignores the case of ASCII letters, other bytes of UTF-8 names are compared as they are
+class CityIndex
+{
+public:
+    using CityId = CityRegistry::CityId;
+
+    // The registry has to outlive the index
+    explicit CityIndex(const CityRegistry &cities);
+
+    CityIndex(const CityIndex &) = delete;
+    CityIndex &operator=(const CityIndex &) = delete;
+
+    // Cities whose name starts with the query, in alphabetical order
+    std::vector<CityId> prefix(std::string_view query) const;
+
+    // Cities whose name contains the query, in ID order, needs at least three characters
+    std::vector<CityId> contains(std::string_view query) const;
+
+    // Prefix matches, or the cities containing the query if no name starts with it
+    std::vector<CityId> search(std::string_view query) const;
+
+private:
+    static uint32_t trigram(std::string_view text, size_t at);
+    const uint32_t *postings(uint32_t key, size_t &count) const;
+
+    const CityRegistry &cities;
+
+    std::vector<CityId> sorted; // All cities ordered by their folded name
+
+    // Posting lists of the trigrams in compressed sparse row form, the IDs of a trigram are
+    // ids[offsets[k]] up to ids[offsets[k + 1]] for keys[k], each list in ascending order
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> offsets;
+    std::vector<CityId> ids;
+};
+
+#endif // CITY_INDEX_H
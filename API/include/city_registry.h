@@ -0,0 +1,81 @@
+/* Author: Jan Šulák
+ * Description: Fixed registry of the supported cities, interned to dense IDs with atomically updated moods.
+ * Date: 9.December 2024
+ */
+
+#ifndef CITY_REGISTRY_H
+#define CITY_REGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "city_catalog.h"
+#include "weather_tables.h"
+
+// Function to convert a mood name sent by the display through the shared perfect hash, returns false for unknown names
+inline bool parseMood(std::string_view name, Mood &mood)
+{
+    return findMood(name.data(), name.size(), mood);
+}
+
+class CityRegistry
+{
+public:
+    using CityId = uint32_t;
+    static const CityId UNKNOWN = UINT32_MAX;
+
+    // Cities with their OpenWeather IDs, the set is fixed for the lifetime of the registry
+    explicit CityRegistry(const std::vector<std::pair<std::string, long>> &cities, Mood initial = Mood::NEUTRAL);
+
+    // Featured cities first, followed by the catalog cities with names not seen yet,
+    // the names are not copied so the catalog has to outlive the registry
+    CityRegistry(const std::vector<std::pair<std::string, long>> &featured, const CityCatalog &catalog, Mood initial = Mood::NEUTRAL);
+
+    CityRegistry(const CityRegistry &) = delete;
+    CityRegistry &operator=(const CityRegistry &) = delete;
+
+    // O(1) lookup through the precomputed hash index, UNKNOWN for cities outside the registry
+    CityId find(std::string_view name) const;
+
+    size_t size() const { return names.size(); }
+    // Featured cities take the IDs below this count, they are prefetched and listed first
+    size_t featured() const { return featuredCount; }
+    // Cities left out because an earlier one has the same name, displays only know cities by their names
+    size_t duplicates() const { return duplicateCount; }
+    std::string_view name(CityId id) const { return names[id]; }
+    long weatherId(CityId id) const { return weatherIds[id]; }
+
+    // Lock-free, safe to call from any thread
+    Mood mood(CityId id) const { return static_cast<Mood>(moods[id].load(std::memory_order_acquire)); }
+
+    // Returns true if the mood changed
+    bool setMood(CityId id, Mood mood)
+    {
+        uint8_t previous = moods[id].exchange(static_cast<uint8_t>(mood), std::memory_order_acq_rel);
+        return previous != static_cast<uint8_t>(mood);
+    }
+
+private:
+    static uint32_t hash(std::string_view name);
+    void reserve(size_t cities);
+    void add(std::string_view name, long weatherId, Mood initial);
+
+    std::vector<std::string> ownedNames; // Storage of the names not backed by a catalog, never reallocated
+    std::vector<std::string_view> names;
+    std::vector<long> weatherIds;
+    std::unique_ptr<std::atomic<uint8_t>[]> moods;
+
+    // Open addressing table of CityId + 1, 0 marks an empty slot
+    std::vector<uint32_t> index;
+    std::vector<uint32_t> indexHashes;
+    uint32_t indexMask = 0;
+    size_t featuredCount = 0;
+    size_t duplicateCount = 0;
+};
+
+#endif // CITY_REGISTRY_H
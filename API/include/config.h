@@ -0,0 +1,54 @@
+/* Author: Jan Šulák
+ * Description: Runtime configuration of the weather MQTT service, read from environment variables.
+ * Date: 9.December 2024
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "mood_journal.h"
+
+struct Config
+{
+    std::string mqttBroker;                // WEATHER_MQTT_BROKER
+    std::string apiKey;                    // WEATHER_API_KEY
+    std::string apiUrl;                    // WEATHER_API_URL, base URL of the OpenWeather API, can point to a mock server
+    std::chrono::seconds cacheTtl;         // WEATHER_CACHE_TTL, data younger than this is served as is
+    std::chrono::seconds cacheStaleTtl;    // WEATHER_CACHE_STALE, data is served stale and refreshed in the background for this long after the TTL
+    std::chrono::seconds statsInterval;    // WEATHER_STATS_INTERVAL, 0 disables periodic statistics logging
+    size_t workers;                        // WEATHER_WORKERS, threads handling requests, defaults to the number of cores
+    size_t queueCapacity;                  // WEATHER_QUEUE_CAPACITY, requests waiting for a worker, further ones are dropped
+    std::chrono::seconds prefetchInterval; // WEATHER_PREFETCH_INTERVAL, period of the background refresh of all cities, 0 disables it
+    bool binaryPayload;                    // WEATHER_BINARY_PAYLOAD, also publish the compact binary payload on <city>/bin
+    size_t publishWindow;                  // WEATHER_PUBLISH_WINDOW, messages sent to the broker and not acknowledged yet
+    size_t publishQueue;                   // WEATHER_PUBLISH_QUEUE, topics waiting for the window before the workers block
+    std::chrono::milliseconds publishAckTimeout; // WEATHER_PUBLISH_ACK_TIMEOUT_MS, an unacknowledged message counts as failed after this long
+    std::chrono::seconds snapshotTtl;      // WEATHER_SNAPSHOT_TTL, an unchanged retained city snapshot is republished after this long
+    MoodJournal::Options journal;          // WEATHER_JOURNAL_SYNC_MS, WEATHER_JOURNAL_SYNC_COUNT and WEATHER_JOURNAL_COMPACT
+    long httpConnections;                  // WEATHER_HTTP_CONNECTIONS, parallel keep-alive connections to the OpenWeather host
+    double upstreamRate;                   // WEATHER_UPSTREAM_RATE, OpenWeather calls allowed per minute, 0 disables the limit
+    size_t upstreamBurst;                  // WEATHER_UPSTREAM_BURST, calls that may go out at once after a quiet period
+    size_t upstreamReserve;                // WEATHER_UPSTREAM_RESERVE, tokens of the burst only display requests may take
+    std::chrono::milliseconds upstreamMaxWait; // WEATHER_UPSTREAM_MAX_WAIT_MS, longest wait of a display request for the quota
+    std::chrono::milliseconds upstreamBackoff; // WEATHER_UPSTREAM_BACKOFF_MS, pause of all calls after the API answers 429
+    std::string cityCatalog;               // WEATHER_CITY_CATALOG, tab-separated catalog of supported cities, only the featured ones if empty
+    size_t listPageSize;                   // WEATHER_LIST_PAGE_SIZE, city names in one page of the cities listing
+    std::string historyFile;               // WEATHER_HISTORY_FILE, memory-mapped readings of the past, "-" disables the history
+    size_t historyCities;                  // WEATHER_HISTORY_CITIES, cities with a history, the first ones to report a reading
+    size_t historyPoints;                  // WEATHER_HISTORY_POINTS, readings kept per city
+    std::string shareGroup;                // WEATHER_SHARE_GROUP, requests are split between the instances of this shared subscription group, empty for a plain subscription
+    std::string instanceId;                // WEATHER_INSTANCE_ID, name of this instance in the replicated mood state, defaults to host-pid
+    std::string traceFile;                 // WEATHER_TRACE_FILE, binary trace of the incoming requests and upstream responses for replays, empty disables it
+    std::chrono::seconds metricsInterval;  // WEATHER_METRICS_INTERVAL, period of the metrics export, 0 disables it
+    std::string metricsFile;               // WEATHER_METRICS_FILE, Prometheus text file for a textfile collector, "-" disables it
+    std::string metricsTopic;              // WEATHER_METRICS_TOPIC, MQTT topic the metrics are published to, "-" disables it
+};
+
+// Function to build the configuration from the environment, falling back to the given defaults
+Config loadConfig(const std::string &defaultBroker, const std::string &defaultApiKey);
+
+#endif // CONFIG_H
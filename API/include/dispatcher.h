@@ -0,0 +1,64 @@
+/* Author: Jan Šulák
+ * Description: Bounded request queue drained by a pool of worker threads, keeping requests for one city in order.
+ * Date: 9.December 2024
+ */
+
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Request parsed from the requests topic, in format "city" or "city mood"
+struct WeatherRequest
+{
+    std::string city;
+    std::string mood; // Empty if the request does not change the mood
+    std::chrono::steady_clock::time_point receivedAt = std::chrono::steady_clock::now(); // Start of the queue wait
+};
+
+class Dispatcher
+{
+public:
+    using Handler = std::function<void(const WeatherRequest &)>;
+
+    Dispatcher(size_t workers, size_t capacity, Handler handler);
+    ~Dispatcher();
+
+    Dispatcher(const Dispatcher &) = delete;
+    Dispatcher &operator=(const Dispatcher &) = delete;
+
+    // Enqueues the request without blocking, returns false if the queue is full or once stopped.
+    // Called from the MQTT callback, which must never wait for the workers.
+    bool submit(WeatherRequest request);
+
+    // Stops accepting requests, finishes the queued ones and joins the workers
+    void stop();
+
+    size_t queued();
+
+private:
+    void workerLoop();
+    bool takeRunnable(WeatherRequest &request);
+
+    const size_t capacity;
+    const Handler handler;
+
+    std::mutex queueMutex;
+    std::condition_variable notEmpty;
+    std::deque<WeatherRequest> queue;
+    std::set<std::string> busyCities; // Cities currently handled by a worker
+    bool stopping = false;
+
+    std::vector<std::thread> threads;
+};
+
+#endif // DISPATCHER_H
@@ -0,0 +1,77 @@
+/* Author: Jan Šulák
+ * Description: Long-lived HTTP client running concurrent transfers on one curl_multi event loop with persistent connections.
+ * Date: 9.December 2024
+ */
+
+#ifndef HTTP_ENGINE_H
+#define HTTP_ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <curl/curl.h>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct HttpResponse
+{
+    long status = 0;       // HTTP status code, 0 if the transfer failed
+    std::string body;
+    std::string error;     // cURL error message of a failed transfer
+    bool reused = false;   // The transfer ran over an already open connection
+    double seconds = 0.0;  // Total time of the transfer
+};
+
+class HttpEngine
+{
+public:
+    struct Stats
+    {
+        uint64_t requests;       // Finished transfers
+        uint64_t newConnections; // Connections opened, the rest of the transfers reused one
+        uint64_t failures;       // Transfers that ended with a cURL error
+    };
+
+    // maxHostConnections limits parallel connections per host, idle ones are kept open for reuse
+    explicit HttpEngine(long maxHostConnections = 8);
+    ~HttpEngine();
+
+    HttpEngine(const HttpEngine &) = delete;
+    HttpEngine &operator=(const HttpEngine &) = delete;
+
+    // Queues a GET request, the future is fulfilled by the event loop
+    std::future<HttpResponse> fetch(const std::string &url);
+
+    Stats stats() const;
+
+private:
+    struct Transfer
+    {
+        std::string url;
+        HttpResponse response;
+        std::promise<HttpResponse> promise;
+        CURL *easy = nullptr;
+    };
+
+    void eventLoop();
+    void startPending();
+    void finishTransfer(CURL *easy, CURLcode result);
+
+    CURLM *multi;
+    std::mutex pendingMutex;
+    std::deque<Transfer *> pending; // Queued by fetch(), added to the multi handle by the event loop
+    std::vector<CURL *> idleHandles; // Easy handles kept for reuse, only touched by the event loop
+    std::set<CURL *> activeHandles;  // Easy handles added to the multi handle, only touched by the event loop
+    std::atomic<bool> stopping{false};
+    std::thread loopThread;
+
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> newConnections{0};
+    std::atomic<uint64_t> failures{0};
+};
+
+#endif // HTTP_ENGINE_H
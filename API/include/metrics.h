@@ -0,0 +1,167 @@
+/* Author: Jan Šulák
+ * Description: Lock-free counters, gauges and log-linear latency histograms with Prometheus text export.
+ * Date: 9.December 2024
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class Counter
+{
+public:
+    void inc(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+class Gauge
+{
+public:
+    void inc() { value.fetch_add(1, std::memory_order_relaxed); }
+    void dec() { value.fetch_sub(1, std::memory_order_relaxed); }
+    void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+    int64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value{0};
+};
+
+// HDR-style histogram of microseconds: 16 linear sub-buckets per power of two, so a recorded
+// value is off by at most 6.25 %, and recording is a single relaxed atomic increment
+class Histogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(uint64_t micros);
+    void record(std::chrono::steady_clock::duration elapsed);
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t sumMicros() const { return sum.load(std::memory_order_relaxed); }
+
+    // Approximate value at the quantile in [0, 1], in microseconds
+    uint64_t quantile(double q) const;
+
+    static int bucketIndex(uint64_t micros);
+    static uint64_t bucketLowerBound(int index);
+
+private:
+    std::atomic<uint64_t> buckets[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+};
+
+// Records the lifetime of the scope into a histogram
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Histogram &histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { histogram.record(std::chrono::steady_clock::now() - start); }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Histogram &histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Increments a gauge for the lifetime of the scope
+class InFlight
+{
+public:
+    explicit InFlight(Gauge &gauge) : gauge(gauge) { gauge.inc(); }
+    ~InFlight() { gauge.dec(); }
+
+    InFlight(const InFlight &) = delete;
+    InFlight &operator=(const InFlight &) = delete;
+
+private:
+    Gauge &gauge;
+};
+
+// Metrics are registered once at startup and live as long as the registry, the hot path only
+// touches the returned references. Names may carry Prometheus labels, e.g. name{stage="fetch"}.
+class MetricsRegistry
+{
+public:
+    Counter &counter(const std::string &name, const std::string &help);
+    Gauge &gauge(const std::string &name, const std::string &help);
+    Histogram &histogram(const std::string &name, const std::string &help);
+
+    // Value read only when exporting, e.g. the depth of a queue owned by another component
+    void gaugeFunction(const std::string &name, const std::string &help, std::function<double()> read);
+    void counterFunction(const std::string &name, const std::string &help, std::function<double()> read);
+
+    // Prometheus text exposition format, histograms are exported as summaries in seconds
+    std::string renderPrometheus();
+
+private:
+    template <typename T>
+    struct Named
+    {
+        std::string name;
+        std::string help;
+        T metric;
+    };
+
+    struct Function
+    {
+        std::string name;
+        std::string help;
+        std::string type;
+        std::function<double()> read;
+    };
+
+    std::mutex registryMutex;
+    std::deque<Named<Counter>> counters;
+    std::deque<Named<Gauge>> gauges;
+    std::deque<Named<Histogram>> histograms;
+    std::deque<Function> functions;
+};
+
+// Periodically writes the metrics to a text file for a Prometheus textfile collector and hands them to a publisher
+class MetricsExporter
+{
+public:
+    using Publisher = std::function<void(const std::string &)>;
+
+    // An empty path disables the file, an empty publisher disables publishing
+    MetricsExporter(MetricsRegistry &registry, std::chrono::seconds interval, std::string path, Publisher publish);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    void exportNow();
+    void stop();
+
+private:
+    void run();
+
+    MetricsRegistry &registry;
+    const std::chrono::seconds interval;
+    const std::string path;
+    const Publisher publish;
+
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif // METRICS_H
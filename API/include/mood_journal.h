@@ -0,0 +1,68 @@
+/* Author: Jan Šulák
+ * Description: Write-behind persistence of city moods, an append-only journal compacted into the data file snapshot.
+ * Date: 9.December 2024
+ */
+
+#ifndef MOOD_JOURNAL_H
+#define MOOD_JOURNAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class MoodJournal
+{
+public:
+    struct Options
+    {
+        std::chrono::milliseconds syncInterval; // Longest time a recorded change waits for fsync
+        size_t syncCount;                       // Changes that trigger fsync before the interval runs out
+        size_t compactAfter;                    // Journal entries after which the snapshot is rewritten
+    };
+
+    // The snapshot keeps the "city<TAB>mood" lines of the data file, the journal is stored next to it
+    MoodJournal(const std::string &snapshotPath, Options options);
+    ~MoodJournal();
+
+    MoodJournal(const MoodJournal &) = delete;
+    MoodJournal &operator=(const MoodJournal &) = delete;
+
+    // Reads the snapshot, replays the journal on top of it and starts the background writer,
+    // cities missing in both keep their default mood
+    std::map<std::string, std::string> load(const std::map<std::string, std::string> &defaults);
+
+    // Queues a mood change, returns without touching the disk
+    void record(const std::string &city, const std::string &mood);
+
+    // Writes, syncs and compacts everything queued, then stops the writer
+    void stop();
+
+private:
+    void writerLoop();
+    bool appendBatch(const std::vector<std::pair<std::string, std::string>> &batch);
+    bool writeSnapshot();
+    void compact();
+
+    const std::string snapshotPath;
+    const std::string journalPath;
+    const Options options;
+
+    std::mutex pendingMutex;
+    std::condition_variable pendingSignal;
+    std::vector<std::pair<std::string, std::string>> pending;
+    bool stopping = false;
+    std::thread writer;
+
+    // Owned by the writer once it runs
+    std::map<std::string, std::string> state;
+    int journalFd = -1;
+    size_t journalEntries = 0;
+};
+
+#endif // MOOD_JOURNAL_H
@@ -0,0 +1,70 @@
+/* Author: Jan Šulák
+ * Description: Mood state replicated between service instances through versioned retained messages.
+ * Date: 9.December 2024
+ */
+
+#ifndef MOOD_REPLICA_H
+#define MOOD_REPLICA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "city_registry.h"
+#include "mood_journal.h"
+
+// Every mood change carries a version per city, the higher version wins and equal versions go to the higher
+// instance name, so all instances converge on the same mood
+class MoodReplica
+{
+public:
+    struct Stats
+    {
+        uint64_t local;   // Changes made by this instance
+        uint64_t applied; // Changes of other instances taken over
+        uint64_t stale;   // State messages ignored as older than the local state
+    };
+
+    // The instance name breaks ties between changes made at the same version
+    MoodReplica(CityRegistry &cities, MoodJournal &journal, std::string instance);
+
+    MoodReplica(const MoodReplica &) = delete;
+    MoodReplica &operator=(const MoodReplica &) = delete;
+
+    // Changes the mood of a city, returns false if it is unchanged,
+    // otherwise the state to publish for the other instances is stored in state
+    bool change(CityRegistry::CityId id, Mood mood, std::string &state);
+
+    // Takes over the "version instance mood" state of a city published by any instance,
+    // returns true if it changed the local mood
+    bool apply(CityRegistry::CityId id, std::string_view state);
+
+    Stats stats() const;
+
+private:
+    static const size_t SHARDS = 64;
+
+    struct Version
+    {
+        uint64_t number = 0; // 0 until the first replicated change, the journal loaded mood loses to any of them
+        std::string origin;
+    };
+
+    CityRegistry &cities;
+    MoodJournal &journal;
+    const std::string instance;
+
+    // Cities map to a shard lock by ID, which keeps the mood, the version and the journal order of one city
+    // consistent. Different cities never wait for each other on the MQTT callback path.
+    std::mutex shardMutexes[SHARDS];
+    std::vector<Version> versions;
+    std::atomic<uint64_t> localCount{0};
+    std::atomic<uint64_t> appliedCount{0};
+    std::atomic<uint64_t> staleCount{0};
+};
+
+#endif // MOOD_REPLICA_H
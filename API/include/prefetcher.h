@@ -0,0 +1,59 @@
+/* Author: Jan Šulák
+ * Description: Background refresh of all known cities through the batched OpenWeather group endpoint.
+ * Date: 9.December 2024
+ */
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Splits a group response {"cnt":N,"list":[{...},{...}]} into the weather objects of the single cities
+std::vector<std::string> splitGroupResponse(const std::string &jsonResponse);
+
+// Returns the top-level "id" of a weather object, or -1 if it has none
+long weatherObjectId(const std::string &jsonObject);
+
+class Prefetcher
+{
+public:
+    // OpenWeather allows at most 20 city IDs in one group query
+    static const size_t GROUP_SIZE = 20;
+
+    using CityList = std::function<std::map<long, std::string>()>;                     // City IDs mapped to city names
+    using GroupFetcher = std::function<std::string(const std::vector<long> &)>;        // Raw group response, empty on failure
+    using CityHandler = std::function<void(const std::string &, const std::string &)>; // City name and its weather object
+
+    Prefetcher(std::chrono::seconds interval, CityList cities, GroupFetcher fetchGroup, CityHandler onCity);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher &) = delete;
+    Prefetcher &operator=(const Prefetcher &) = delete;
+
+    // Refreshes every city once, returns the number of cities updated
+    size_t refreshAll();
+
+    void stop();
+
+private:
+    void run();
+
+    const std::chrono::seconds interval;
+    const CityList cities;
+    const GroupFetcher fetchGroup;
+    const CityHandler onCity;
+
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif // PREFETCHER_H
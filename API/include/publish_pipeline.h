@@ -0,0 +1,114 @@
+/* Author: Jan Šulák
+ * Description: Outgoing MQTT messages with a bounded in-flight window, per-topic coalescing and delivery tracking.
+ * Date: 9.December 2024
+ */
+
+#ifndef PUBLISH_PIPELINE_H
+#define PUBLISH_PIPELINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "metrics.h"
+
+struct OutgoingMessage
+{
+    std::string topic;
+    std::string payload;
+    int qos = 1;
+    bool retained = false;
+    std::function<void(bool)> done; // Optional, called with the delivery result, not for superseded messages
+};
+
+class PublishPipeline
+{
+public:
+    // Hands the message to the client, the delivery result has to be reported through complete() with the
+    // same token. A thrown exception counts as a failed delivery.
+    using Sender = std::function<void(const OutgoingMessage &, uint64_t)>;
+
+    struct Stats
+    {
+        uint64_t sent;      // Handed to the client
+        uint64_t acked;     // Confirmed by the broker
+        uint64_t failed;    // Rejected, failed or not confirmed within the ack timeout
+        uint64_t coalesced; // Replaced by a newer message for the same topic before being sent
+        uint64_t dropped;   // Refused by tryPublish() because the queue was full
+        size_t inFlight;
+        size_t pending;
+    };
+
+    // window: messages sent but not confirmed yet, capacity: topics waiting for a free slot before publish() blocks
+    PublishPipeline(size_t window, size_t capacity, std::chrono::milliseconds ackTimeout, Histogram &ackLatency, Sender sender);
+    ~PublishPipeline();
+
+    PublishPipeline(const PublishPipeline &) = delete;
+    PublishPipeline &operator=(const PublishPipeline &) = delete;
+
+    // Queues the message, replacing one still waiting for the same topic. Blocks while the queue is full,
+    // which holds back the request workers. Must not be called from the MQTT callback, whose thread also
+    // delivers the acknowledgements that free the queue. Returns false once stopped.
+    bool publish(OutgoingMessage message);
+
+    // Same as publish() without blocking, a message that finds the queue full is dropped, counted and
+    // reported through done. For the replies sent from the MQTT callback.
+    bool tryPublish(OutgoingMessage message);
+
+    // Delivery result of a sent message, late results after the ack timeout are ignored
+    void complete(uint64_t token, bool delivered);
+
+    // Waits until nothing is pending or in flight, returns false on timeout
+    bool flush(std::chrono::milliseconds timeout);
+
+    void stop();
+
+    Stats stats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct InFlight
+    {
+        Clock::time_point sentAt;
+        std::function<void(bool)> done;
+    };
+
+    bool enqueue(OutgoingMessage message, bool wait);
+    void senderLoop();
+    void expireLocked(Clock::time_point now, std::deque<std::pair<std::function<void(bool)>, bool>> &results);
+
+    const size_t window;
+    const size_t capacity;
+    const std::chrono::milliseconds ackTimeout;
+    Histogram &ackLatency;
+    const Sender sender;
+
+    std::mutex pipelineMutex;
+    std::condition_variable canSend;  // A message is pending and a slot is free, or stopping
+    std::condition_variable canQueue; // The queue has room
+    std::condition_variable drained;  // Nothing pending or in flight
+    std::deque<std::string> order;    // Pending topics, oldest first
+    std::unordered_map<std::string, OutgoingMessage> pending;
+    std::map<uint64_t, InFlight> inFlight; // Ordered by token, so the oldest is first
+    uint64_t nextToken = 1;
+    bool stopping = false;
+
+    uint64_t sent = 0;
+    uint64_t acked = 0;
+    uint64_t failed = 0;
+    uint64_t coalesced = 0;
+    uint64_t dropped = 0;
+
+    std::thread worker;
+};
+
+#endif // PUBLISH_PIPELINE_H
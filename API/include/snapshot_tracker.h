@@ -0,0 +1,42 @@
+/* Author: Jan Šulák
+ * Description: Last published weather snapshot per city, deciding when the retained city topics need republishing.
+ * Date: 9.December 2024
+ */
+
+#ifndef SNAPSHOT_TRACKER_H
+#define SNAPSHOT_TRACKER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "weather_payload.h"
+
+class SnapshotTracker
+{
+public:
+    // Cities are addressed by their registry ID
+    SnapshotTracker(size_t cities, std::chrono::seconds ttl);
+
+    SnapshotTracker(const SnapshotTracker &) = delete;
+    SnapshotTracker &operator=(const SnapshotTracker &) = delete;
+
+    // Returns true and records the snapshot if its temperature, humidity or mood differ from the
+    // last published one or that one is older than the TTL. Lock-free, one caller wins a race.
+    // A forced claim always records the snapshot and returns true.
+    bool claim(size_t city, const WeatherPayload &snapshot, bool force = false);
+
+    // Forgets the last snapshot after a failed publish so the next one goes out
+    void reset(size_t city);
+
+private:
+    // Snapshot values in the upper 32 bits, seconds since construction + 1 in the lower ones, 0 if never published
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    const size_t cities;
+    const std::chrono::seconds ttl;
+    const std::chrono::steady_clock::time_point start;
+};
+
+#endif // SNAPSHOT_TRACKER_H
@@ -0,0 +1,87 @@
+/* Author: Jan Šulák
+ * Description: Compact binary trace of the incoming MQTT messages and upstream HTTP responses, for recording and replaying traffic.
+ * Date: 9.December 2024
+ */
+
+#ifndef TRAFFIC_TRACE_H
+#define TRAFFIC_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// File layout: the 8 byte magic "WTRACE\0\1" followed by records of
+//   uint8  kind
+//   uint8  reserved, 0
+//   uint16 HTTP status of a response, 0 for a message
+//   uint64 microseconds since the start of the recording, little-endian like all fields
+//   uint32 key length, the topic of a message or the request key of a response
+//   uint32 body length
+//   key and body bytes
+struct TraceRecord
+{
+    enum Kind : uint8_t
+    {
+        MESSAGE = 1,  // MQTT message received by the service
+        RESPONSE = 2, // Response of the OpenWeather API
+    };
+
+    Kind kind = MESSAGE;
+    uint16_t status = 0;
+    uint64_t micros = 0;
+    std::string key;
+    std::string body;
+};
+
+// Function to reduce a request URL or target to the part shared by the real and the mock API, e.g.
+// "http://api.openweathermap.org/data/2.5/weather?q=Brno&appid=KEY&units=metric" to "/weather?q=Brno&units=metric",
+// dropping the API key so it never ends up in a trace
+std::string traceRequestKey(const std::string &url);
+
+class TraceWriter
+{
+public:
+    TraceWriter() = default;
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    // Truncates the file and starts the clock of the recording, returns false if it cannot be created
+    bool open(const std::string &path);
+    bool isOpen() const { return file != nullptr; }
+
+    // Safe to call from any thread, does nothing while the writer is closed
+    void record(TraceRecord::Kind kind, const std::string &key, const std::string &body, uint16_t status = 0);
+
+    // Flushes the buffered records and closes the file
+    void close();
+
+private:
+    std::mutex fileMutex;
+    FILE *file = nullptr;
+    std::chrono::steady_clock::time_point start;
+};
+
+class TraceReader
+{
+public:
+    TraceReader() = default;
+    ~TraceReader();
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    // Returns false if the file cannot be read or is not a trace
+    bool open(const std::string &path);
+
+    // Reads the next record, returns false at the end of the trace or at a truncated record
+    bool next(TraceRecord &record);
+
+private:
+    FILE *file = nullptr;
+};
+
+#endif // TRAFFIC_TRACE_H
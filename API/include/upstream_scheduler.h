@@ -0,0 +1,76 @@
+/* Author: Jan Šulák
+ * Description: Token bucket in front of the OpenWeather API, granting calls by priority within the per-minute quota.
+ * Date: 9.December 2024
+ */
+
+#ifndef UPSTREAM_SCHEDULER_H
+#define UPSTREAM_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+class UpstreamScheduler
+{
+public:
+    // Lower values preempt higher ones, a call waits until no call of a more important class waits
+    enum Priority
+    {
+        INTERACTIVE, // Cache miss of a display request, someone waits for the reply
+        REFRESH,     // Revalidation of stale data, the stale data is served meanwhile
+        PREFETCH,    // Periodic refresh of the featured cities
+        PRIORITIES,
+    };
+
+    struct Stats
+    {
+        uint64_t granted[PRIORITIES];  // Calls let through
+        uint64_t deferred[PRIORITIES]; // Calls given up because no token was free in time
+        size_t waiting[PRIORITIES];    // Calls waiting for a token right now
+        uint64_t throttled;            // Rate limit responses of the upstream
+    };
+
+    // Refills callsPerMinute tokens a minute up to burst, 0 calls per minute disables the limit.
+    // The last reserve tokens are kept for interactive calls.
+    UpstreamScheduler(double callsPerMinute, size_t burst, size_t reserve);
+
+    UpstreamScheduler(const UpstreamScheduler &) = delete;
+    UpstreamScheduler &operator=(const UpstreamScheduler &) = delete;
+
+    // Waits up to maxWait for a token, returns false if the call has to be skipped
+    bool acquire(Priority priority, std::chrono::milliseconds maxWait);
+
+    // The upstream answered with a rate limit error, empties the bucket and grants nothing for pause
+    void throttle(std::chrono::milliseconds pause);
+
+    // Refuses the waiting and all further background calls, interactive calls are still granted
+    // so the requests queued at shutdown can finish
+    void stop();
+
+    Stats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void refill(Clock::time_point now);
+    bool mayTake(Priority priority, uint64_t ticket) const;
+
+    const double tokensPerSecond;
+    const double burst;
+    const double reserve;
+
+    mutable std::mutex bucketMutex;
+    std::condition_variable changed;
+    double tokens;
+    Clock::time_point refilledAt;
+    Clock::time_point pausedUntil;
+    std::deque<uint64_t> queues[PRIORITIES]; // Tickets of the waiting calls, served first come first served
+    uint64_t nextTicket = 0;
+    bool stopping = false;
+    Stats counters{};
+};
+
+#endif // UPSTREAM_SCHEDULER_H
@@ -0,0 +1,81 @@
+/* Author: Jan Šulák
+ * Description: Per-city cache of OpenWeather responses with stale-while-revalidate and single-flight fetching.
+ * Date: 9.December 2024
+ */
+
+#ifndef WEATHER_CACHE_H
+#define WEATHER_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+
+class WeatherCache
+{
+public:
+    // Fetches the raw response for a city, returns an empty string on failure.
+    // Background is set for the revalidation of stale data, which nobody waits for.
+    using Fetcher = std::function<std::string(const std::string &, bool background)>;
+
+    struct Stats
+    {
+        uint64_t hits;      // Served fresh from the cache
+        uint64_t staleHits; // Served stale while a background refresh was started
+        uint64_t misses;    // Required a blocking upstream fetch
+        uint64_t coalesced; // Waited for a fetch started by another request
+        uint64_t failures;  // Upstream fetches that returned no data
+    };
+
+    WeatherCache(std::chrono::milliseconds ttl, std::chrono::milliseconds staleTtl, Fetcher fetcher);
+    ~WeatherCache();
+
+    WeatherCache(const WeatherCache &) = delete;
+    WeatherCache &operator=(const WeatherCache &) = delete;
+
+    // Returns the weather data of the city, fetching it upstream only when needed
+    std::string get(const std::string &city);
+
+    // Stores data fetched outside of the cache, e.g. by the background prefetcher
+    void put(const std::string &city, const std::string &data);
+
+    Stats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string data;
+        Clock::time_point fetchedAt;
+        bool valid = false;
+        bool inFlight = false;
+        std::shared_future<std::string> pending; // Result of the fetch in flight
+    };
+
+    std::string fetchAndStore(const std::string &city, bool background, std::promise<std::string> &promise);
+    void refreshInBackground(const std::string &city);
+
+    const std::chrono::milliseconds ttl;
+    const std::chrono::milliseconds staleTtl;
+    const Fetcher fetcher;
+
+    std::mutex entriesMutex;
+    std::map<std::string, Entry> entries;
+
+    std::condition_variable refreshesDone;
+    int refreshesRunning = 0;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> staleHits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> coalesced{0};
+    std::atomic<uint64_t> failures{0};
+};
+
+#endif // WEATHER_CACHE_H
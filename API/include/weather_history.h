@@ -0,0 +1,87 @@
+/* Author: Jan Šulák
+ * Description: Memory-mapped columnar ring buffers of past temperature and humidity readings per city.
+ * Date: 9.December 2024
+ */
+
+#ifndef WEATHER_HISTORY_H
+#define WEATHER_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The file holds a header, one slot descriptor per city and three column arrays. Slot s owns the
+// elements [s * capacity, (s + 1) * capacity) of each column and writes them as a ring buffer.
+class WeatherHistory
+{
+public:
+    struct Bucket
+    {
+        uint32_t from;      // Start of the bucket
+        uint32_t count;     // Readings in the bucket, 0 for a gap
+        double temperature; // Averages in degrees Celsius and percent
+        double humidity;
+    };
+
+    struct Summary
+    {
+        uint32_t count = 0; // Readings in the window
+        uint32_t first = 0; // Timestamps of the oldest and newest of them
+        uint32_t last = 0;
+        double temperatureMin = 0, temperatureMax = 0, temperatureAvg = 0;
+        double humidityMin = 0, humidityMax = 0, humidityAvg = 0;
+        std::vector<Bucket> series; // The window split into equal buckets
+    };
+
+    // slots: cities with a history, capacity: readings kept per city
+    WeatherHistory(size_t slots, size_t capacity);
+    ~WeatherHistory();
+
+    WeatherHistory(const WeatherHistory &) = delete;
+    WeatherHistory &operator=(const WeatherHistory &) = delete;
+
+    // Maps the file, creating it or starting over if its dimensions differ, returns false if it cannot be mapped
+    bool open(const std::string &path);
+
+    // Appends a reading, ignored unless it is newer than the last one of the city or if all slots are taken
+    bool append(long weatherId, uint32_t timestamp, int16_t temperatureTenths, uint8_t humidity);
+
+    // Aggregates the readings with timestamps in [from, to], returns false if the city has none at all
+    bool query(long weatherId, uint32_t from, uint32_t to, size_t points, Summary &summary);
+
+    size_t cities();
+
+private:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotCount;
+        uint64_t capacity;
+    };
+
+    struct Slot
+    {
+        int64_t weatherId; // 0 for a free slot
+        uint64_t written;  // Readings appended since the slot was taken
+    };
+
+    size_t fileSize() const;
+
+    const size_t slotCount;
+    const size_t capacity;
+
+    std::mutex historyMutex;
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    Slot *slots = nullptr;
+    uint32_t *timestamps = nullptr;
+    int16_t *temperatures = nullptr;
+    uint8_t *humidities = nullptr;
+    std::unordered_map<long, size_t> slotOf; // OpenWeather ID to slot
+};
+
+#endif // WEATHER_HISTORY_H
@@ -0,0 +1,56 @@
+/* Author: Jan Šulák
+ * Description: Single-pass, allocation-free parser of OpenWeather current weather responses.
+ * Date: 9.December 2024
+ */
+
+#ifndef WEATHER_PARSER_H
+#define WEATHER_PARSER_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+struct WeatherReading
+{
+    // Bits of the fields found in the response
+    enum Field : uint32_t
+    {
+        TEMP = 1 << 0,
+        FEELS_LIKE = 1 << 1,
+        HUMIDITY = 1 << 2,
+        PRESSURE = 1 << 3,
+        WIND_SPEED = 1 << 4,
+        WIND_DEG = 1 << 5,
+        CITY_ID = 1 << 6,
+        TIMESTAMP = 1 << 7,
+    };
+    static const uint32_t REQUIRED = TEMP | HUMIDITY;
+
+    double temperature = 0.0; // main.temp, degrees Celsius with units=metric
+    double feelsLike = 0.0;   // main.feels_like
+    int humidity = 0;         // main.humidity, percent
+    int pressure = 0;         // main.pressure, hPa
+    double windSpeed = 0.0;   // wind.speed, m/s
+    int windDeg = 0;          // wind.deg
+    long cityId = 0;          // id
+    int64_t timestamp = 0;    // dt, Unix time of the measurement
+    uint32_t fields = 0;
+};
+
+enum class ParseStatus
+{
+    OK,
+    MALFORMED,     // Not valid JSON
+    MISSING_FIELD, // Valid JSON without a numeric temperature or humidity
+};
+
+// Function to parse the response in one pass over the input, without copying it
+ParseStatus parseWeather(std::string_view json, WeatherReading &reading);
+
+// Function to split the "list" array of a group response {"cnt":N,"list":[{...},{...}]} into views of its
+// weather objects, each of which parseWeather accepts, MISSING_FIELD if the list is absent or empty
+ParseStatus splitWeatherList(std::string_view json, std::vector<std::string_view> &objects);
+
+const char *parseStatusName(ParseStatus status);
+
+#endif // WEATHER_PARSER_H
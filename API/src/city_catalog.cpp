@@ -0,0 +1,148 @@
+/* Author: Jan Šulák
+ * Description: Read-only city catalog memory-mapped from a tab-separated file of OpenWeather cities.
+ * Date: 9.December 2024
+ */
+
+#include "city_catalog.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+CityCatalog::~CityCatalog()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<char *>(data), length);
+    }
+}
+
+// Function to cut the next tab-separated field off the line
+static string_view nextField(string_view &line)
+{
+    size_t tab = line.find('\t');
+    string_view field = line.substr(0, tab);
+    line = tab == string_view::npos ? string_view() : line.substr(tab + 1);
+    return field;
+}
+
+// Function to parse a decimal coordinate, strtof needs a terminated copy of the field
+static bool parseCoordinate(string_view field, float &value)
+{
+    char buffer[32];
+    if (field.empty() || field.size() >= sizeof(buffer))
+    {
+        return false;
+    }
+    field.copy(buffer, field.size());
+    buffer[field.size()] = '\0';
+    char *end = nullptr;
+    value = strtof(buffer, &end);
+    return *end == '\0';
+}
+
+// Function to tell whether the name can be used as an MQTT topic, wildcards, levels and control characters cannot
+static bool isTopicSafe(string_view name)
+{
+    for (char c : name)
+    {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (c == '/' || c == '+' || c == '#' || u < 0x20 || u == 0x7F)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CityCatalog::parseLine(string_view line, size_t offset)
+{
+    string_view rest = line;
+    string_view id = nextField(rest);
+    string_view name = nextField(rest);
+    string_view country = nextField(rest);
+    string_view latitude = nextField(rest);
+    string_view longitude = nextField(rest);
+
+    Record record;
+    auto result = from_chars(id.data(), id.data() + id.size(), record.weatherId);
+    if (result.ec != errc() || result.ptr != id.data() + id.size() || name.empty() || name.size() > UINT16_MAX || country.size() > 2 ||
+        !isTopicSafe(name))
+    {
+        return false;
+    }
+    if (!parseCoordinate(latitude, record.latitude) || !parseCoordinate(longitude, record.longitude))
+    {
+        return false;
+    }
+    record.nameOffset = static_cast<uint32_t>(offset + (name.data() - line.data()));
+    record.nameLength = static_cast<uint16_t>(name.size());
+    record.country[0] = country.size() > 0 ? country[0] : '\0';
+    record.country[1] = country.size() > 1 ? country[1] : '\0';
+    records.push_back(record);
+    return true;
+}
+
+bool CityCatalog::load(const string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        cerr << "Failed to open city catalog: " << path << endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0 || static_cast<uint64_t>(info.st_size) > UINT32_MAX)
+    {
+        cerr << "Invalid city catalog: " << path << endl;
+        close(fd);
+        return false;
+    }
+    void *mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (mapping == MAP_FAILED)
+    {
+        cerr << "Failed to map city catalog: " << path << endl;
+        return false;
+    }
+    madvise(mapping, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+    data = static_cast<const char *>(mapping);
+    length = static_cast<size_t>(info.st_size);
+
+    // Reserve for an average line of about 40 bytes to avoid regrowing the records while scanning
+    records.reserve(length / 40);
+    size_t skipped = 0;
+    size_t lineStart = 0;
+    while (lineStart < length)
+    {
+        const void *newline = memchr(data + lineStart, '\n', length - lineStart);
+        size_t lineEnd = newline != nullptr ? static_cast<size_t>(static_cast<const char *>(newline) - data) : length;
+        string_view line(data + lineStart, lineEnd - lineStart);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (!line.empty() && line[0] != '#' && !parseLine(line, lineStart))
+        {
+            ++skipped;
+        }
+        lineStart = lineEnd + 1;
+    }
+    records.shrink_to_fit();
+    // Only the names are read from now on, and only through lookups and listings
+    madvise(mapping, length, MADV_RANDOM);
+
+    if (skipped > 0)
+    {
+        cerr << "Skipped " << skipped << " malformed lines of the city catalog" << endl;
+    }
+    cout << "Loaded " << records.size() << " cities from " << path << endl;
+    return true;
+}
@@ -0,0 +1,171 @@
+/* Author: Jan Šulák
+ * Description: Prefix and trigram search over the city names of the registry.
+ * Date: 9.December 2024
+ */
+
+#include "city_index.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+using namespace std;
+
+static inline unsigned char fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : static_cast<unsigned char>(c);
+}
+
+// Function to compare two names as if both were folded to lower case
+static bool foldedLess(string_view a, string_view b)
+{
+    size_t n = min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i)
+    {
+        unsigned char x = fold(a[i]);
+        unsigned char y = fold(b[i]);
+        if (x != y)
+        {
+            return x < y;
+        }
+    }
+    return a.size() < b.size();
+}
+
+static bool foldedStartsWith(string_view name, string_view query)
+{
+    if (name.size() < query.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < query.size(); ++i)
+    {
+        if (fold(name[i]) != fold(query[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool foldedContains(string_view name, string_view query)
+{
+    for (size_t at = 0; at + query.size() <= name.size(); ++at)
+    {
+        if (foldedStartsWith(name.substr(at), query))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t CityIndex::trigram(string_view text, size_t at)
+{
+    return (static_cast<uint32_t>(fold(text[at])) << 16) | (static_cast<uint32_t>(fold(text[at + 1])) << 8) | fold(text[at + 2]);
+}
+
+CityIndex::CityIndex(const CityRegistry &cities) : cities(cities)
+{
+    sorted.resize(cities.size());
+    for (CityId id = 0; id < cities.size(); ++id)
+    {
+        sorted[id] = id;
+    }
+    sort(sorted.begin(), sorted.end(), [&cities](CityId a, CityId b)
+         { return foldedLess(cities.name(a), cities.name(b)); });
+
+    // Collect (trigram, city) pairs, sorting them groups the posting lists and keeps each in ID order
+    vector<pair<uint32_t, CityId>> pairs;
+    for (CityId id = 0; id < cities.size(); ++id)
+    {
+        string_view name = cities.name(id);
+        for (size_t at = 0; at + 3 <= name.size(); ++at)
+        {
+            pairs.emplace_back(trigram(name, at), id);
+        }
+    }
+    sort(pairs.begin(), pairs.end());
+    pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+
+    ids.reserve(pairs.size());
+    for (const auto &entry : pairs)
+    {
+        if (keys.empty() || keys.back() != entry.first)
+        {
+            keys.push_back(entry.first);
+            offsets.push_back(static_cast<uint32_t>(ids.size()));
+        }
+        ids.push_back(entry.second);
+    }
+    offsets.push_back(static_cast<uint32_t>(ids.size()));
+    keys.shrink_to_fit();
+    offsets.shrink_to_fit();
+}
+
+const uint32_t *CityIndex::postings(uint32_t key, size_t &count) const
+{
+    auto it = lower_bound(keys.begin(), keys.end(), key);
+    if (it == keys.end() || *it != key)
+    {
+        count = 0;
+        return nullptr;
+    }
+    size_t k = static_cast<size_t>(it - keys.begin());
+    count = offsets[k + 1] - offsets[k];
+    return ids.data() + offsets[k];
+}
+
+vector<CityIndex::CityId> CityIndex::prefix(string_view query) const
+{
+    auto first = lower_bound(sorted.begin(), sorted.end(), query, [this](CityId id, string_view q)
+                             { return foldedLess(cities.name(id), q); });
+    vector<CityId> result;
+    for (auto it = first; it != sorted.end() && foldedStartsWith(cities.name(*it), query); ++it)
+    {
+        result.push_back(*it);
+    }
+    return result;
+}
+
+vector<CityIndex::CityId> CityIndex::contains(string_view query) const
+{
+    vector<CityId> result;
+    if (query.size() < 3)
+    {
+        return result;
+    }
+    // Start from the rarest trigram of the query and intersect it with the others
+    vector<pair<const uint32_t *, size_t>> lists;
+    for (size_t at = 0; at + 3 <= query.size(); ++at)
+    {
+        size_t count;
+        const uint32_t *list = postings(trigram(query, at), count);
+        if (count == 0)
+        {
+            return result;
+        }
+        lists.emplace_back(list, count);
+    }
+    sort(lists.begin(), lists.end(), [](const pair<const uint32_t *, size_t> &a, const pair<const uint32_t *, size_t> &b)
+         { return a.second < b.second; });
+
+    result.assign(lists[0].first, lists[0].first + lists[0].second);
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i)
+    {
+        vector<CityId> kept;
+        set_intersection(result.begin(), result.end(), lists[i].first, lists[i].first + lists[i].second, back_inserter(kept));
+        result.swap(kept);
+    }
+    // Sharing all trigrams does not mean the name contains them in a row
+    result.erase(remove_if(result.begin(), result.end(), [this, query](CityId id)
+                           { return !foldedContains(cities.name(id), query); }),
+                 result.end());
+    return result;
+}
+
+vector<CityIndex::CityId> CityIndex::search(string_view query) const
+{
+    vector<CityId> result = prefix(query);
+    return result.empty() ? contains(query) : result;
+}
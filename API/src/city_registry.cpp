@@ -0,0 +1,98 @@
+/* Author: Jan Šulák
+ * Description: Fixed registry of the supported cities, interned to dense IDs with atomically updated moods.
+ * Date: 9.December 2024
+ */
+
+#include "city_registry.h"
+
+using namespace std;
+
+// FNV-1a
+uint32_t CityRegistry::hash(string_view name)
+{
+    uint32_t h = 2166136261u;
+    for (char c : name)
+    {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void CityRegistry::reserve(size_t cities)
+{
+    moods.reset(new atomic<uint8_t>[cities]);
+    names.reserve(cities);
+    weatherIds.reserve(cities);
+
+    // Keep the table at most half full so probe sequences stay short
+    size_t capacity = 1;
+    while (capacity < cities * 2)
+    {
+        capacity <<= 1;
+    }
+    index.assign(capacity, 0);
+    indexHashes.assign(capacity, 0);
+    indexMask = static_cast<uint32_t>(capacity - 1);
+}
+
+void CityRegistry::add(string_view name, long weatherId, Mood initial)
+{
+    uint32_t h = hash(name);
+    uint32_t slot = h & indexMask;
+    for (; index[slot] != 0; slot = (slot + 1) & indexMask)
+    {
+        if (indexHashes[slot] == h && names[index[slot] - 1] == name)
+        {
+            duplicateCount++; // Duplicate name, keep the first one
+            return;
+        }
+    }
+    CityId id = static_cast<CityId>(names.size());
+    names.push_back(name);
+    weatherIds.push_back(weatherId);
+    moods[id].store(static_cast<uint8_t>(initial), memory_order_relaxed);
+    index[slot] = id + 1;
+    indexHashes[slot] = h;
+}
+
+CityRegistry::CityRegistry(const vector<pair<string, long>> &cities, Mood initial)
+{
+    reserve(cities.size());
+    ownedNames.reserve(cities.size());
+    for (const auto &city : cities)
+    {
+        ownedNames.push_back(city.first);
+        add(ownedNames.back(), city.second, initial);
+    }
+    featuredCount = names.size();
+}
+
+CityRegistry::CityRegistry(const vector<pair<string, long>> &featured, const CityCatalog &catalog, Mood initial)
+{
+    reserve(featured.size() + catalog.size());
+    ownedNames.reserve(featured.size());
+    for (const auto &city : featured)
+    {
+        ownedNames.push_back(city.first);
+        add(ownedNames.back(), city.second, initial);
+    }
+    featuredCount = names.size();
+    for (size_t i = 0; i < catalog.size(); ++i)
+    {
+        add(catalog.name(i), catalog.weatherId(i), initial);
+    }
+}
+
+CityRegistry::CityId CityRegistry::find(string_view name) const
+{
+    uint32_t h = hash(name);
+    for (uint32_t slot = h & indexMask; index[slot] != 0; slot = (slot + 1) & indexMask)
+    {
+        if (indexHashes[slot] == h && names[index[slot] - 1] == name)
+        {
+            return index[slot] - 1;
+        }
+    }
+    return UNKNOWN;
+}
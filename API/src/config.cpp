@@ -0,0 +1,97 @@
+/* Author: Jan Šulák
+ * Description: Runtime configuration of the weather MQTT service, read from environment variables.
+ * Date: 9.December 2024
+ */
+
+#include "config.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+// Function to read a string variable from the environment
+static string envString(const char *name, const string &fallback)
+{
+    const char *value = getenv(name);
+    return (value != nullptr && *value != '\0') ? string(value) : fallback;
+}
+
+// Function to read a non-negative integer variable from the environment
+static long envNumber(const char *name, long fallback)
+{
+    const char *value = getenv(name);
+    if (value == nullptr || *value == '\0')
+    {
+        return fallback;
+    }
+    char *end = nullptr;
+    long number = strtol(value, &end, 10);
+    if (*end != '\0' || number < 0)
+    {
+        cerr << "Invalid value of " << name << ": " << value << ", using " << fallback << endl;
+        return fallback;
+    }
+    return number;
+}
+
+Config loadConfig(const string &defaultBroker, const string &defaultApiKey)
+{
+    Config config;
+    config.mqttBroker = envString("WEATHER_MQTT_BROKER", defaultBroker);
+    config.apiKey = envString("WEATHER_API_KEY", defaultApiKey);
+    config.apiUrl = envString("WEATHER_API_URL", "http://api.openweathermap.org/data/2.5");
+    config.cacheTtl = chrono::seconds(envNumber("WEATHER_CACHE_TTL", 60));
+    config.cacheStaleTtl = chrono::seconds(envNumber("WEATHER_CACHE_STALE", 300));
+    config.statsInterval = chrono::seconds(envNumber("WEATHER_STATS_INTERVAL", 60));
+    long cores = static_cast<long>(thread::hardware_concurrency());
+    config.workers = static_cast<size_t>(envNumber("WEATHER_WORKERS", cores > 0 ? cores : 1));
+    config.prefetchInterval = chrono::seconds(envNumber("WEATHER_PREFETCH_INTERVAL", 300));
+    config.binaryPayload = envNumber("WEATHER_BINARY_PAYLOAD", 1) != 0;
+    config.publishWindow = static_cast<size_t>(envNumber("WEATHER_PUBLISH_WINDOW", 64));
+    config.publishQueue = static_cast<size_t>(envNumber("WEATHER_PUBLISH_QUEUE", 1024));
+    config.publishAckTimeout = chrono::milliseconds(envNumber("WEATHER_PUBLISH_ACK_TIMEOUT_MS", 10000));
+    config.snapshotTtl = chrono::seconds(envNumber("WEATHER_SNAPSHOT_TTL", 600));
+    config.journal.syncInterval = chrono::milliseconds(envNumber("WEATHER_JOURNAL_SYNC_MS", 1000));
+    config.journal.syncCount = static_cast<size_t>(envNumber("WEATHER_JOURNAL_SYNC_COUNT", 64));
+    config.journal.compactAfter = static_cast<size_t>(envNumber("WEATHER_JOURNAL_COMPACT", 1024));
+    config.httpConnections = envNumber("WEATHER_HTTP_CONNECTIONS", 8);
+    config.queueCapacity = static_cast<size_t>(envNumber("WEATHER_QUEUE_CAPACITY", 1024));
+    config.upstreamRate = static_cast<double>(envNumber("WEATHER_UPSTREAM_RATE", 60));
+    config.upstreamBurst = static_cast<size_t>(envNumber("WEATHER_UPSTREAM_BURST", 10));
+    config.upstreamReserve = static_cast<size_t>(envNumber("WEATHER_UPSTREAM_RESERVE", 2));
+    config.upstreamMaxWait = chrono::milliseconds(envNumber("WEATHER_UPSTREAM_MAX_WAIT_MS", 3000));
+    config.upstreamBackoff = chrono::milliseconds(envNumber("WEATHER_UPSTREAM_BACKOFF_MS", 10000));
+    config.cityCatalog = envString("WEATHER_CITY_CATALOG", "");
+    config.listPageSize = static_cast<size_t>(envNumber("WEATHER_LIST_PAGE_SIZE", 10));
+    if (config.listPageSize == 0)
+    {
+        config.listPageSize = 1;
+    }
+    config.historyFile = envString("WEATHER_HISTORY_FILE", "history.dat");
+    if (config.historyFile == "-")
+    {
+        config.historyFile.clear();
+    }
+    config.historyCities = static_cast<size_t>(envNumber("WEATHER_HISTORY_CITIES", 256));
+    config.historyPoints = static_cast<size_t>(envNumber("WEATHER_HISTORY_POINTS", 16384));
+    config.shareGroup = envString("WEATHER_SHARE_GROUP", "");
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    config.instanceId = envString("WEATHER_INSTANCE_ID", string(host) + "-" + to_string(getpid()));
+    config.traceFile = envString("WEATHER_TRACE_FILE", "");
+    config.metricsInterval = chrono::seconds(envNumber("WEATHER_METRICS_INTERVAL", 15));
+    config.metricsFile = envString("WEATHER_METRICS_FILE", "metrics.prom");
+    config.metricsTopic = envString("WEATHER_METRICS_TOPIC", "$metrics");
+    if (config.metricsFile == "-")
+    {
+        config.metricsFile.clear();
+    }
+    if (config.metricsTopic == "-")
+    {
+        config.metricsTopic.clear();
+    }
+    return config;
+}
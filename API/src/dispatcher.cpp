@@ -0,0 +1,117 @@
+/* Author: Jan Šulák
+ * Description: Bounded request queue drained by a pool of worker threads, keeping requests for one city in order.
+ * Date: 9.December 2024
+ */
+
+#include "dispatcher.h"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+Dispatcher::Dispatcher(size_t workers, size_t capacity, Handler handler)
+    : capacity(capacity > 0 ? capacity : 1), handler(move(handler))
+{
+    if (workers == 0)
+    {
+        workers = 1;
+    }
+    for (size_t i = 0; i < workers; ++i)
+    {
+        threads.emplace_back(&Dispatcher::workerLoop, this);
+    }
+}
+
+Dispatcher::~Dispatcher()
+{
+    stop();
+}
+
+bool Dispatcher::submit(WeatherRequest request)
+{
+    unique_lock<mutex> lock(queueMutex);
+    if (stopping || queue.size() >= capacity)
+    {
+        return false;
+    }
+    queue.push_back(move(request));
+    lock.unlock();
+    notEmpty.notify_all();
+    return true;
+}
+
+void Dispatcher::stop()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    for (thread &worker : threads)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+size_t Dispatcher::queued()
+{
+    lock_guard<mutex> lock(queueMutex);
+    return queue.size();
+}
+
+// Function to take the oldest request whose city is not being handled by another worker,
+// must be called with queueMutex held
+bool Dispatcher::takeRunnable(WeatherRequest &request)
+{
+    for (auto it = queue.begin(); it != queue.end(); ++it)
+    {
+        if (busyCities.count(it->city) == 0)
+        {
+            request = move(*it);
+            queue.erase(it);
+            busyCities.insert(request.city);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Dispatcher::workerLoop()
+{
+    unique_lock<mutex> lock(queueMutex);
+    while (true)
+    {
+        WeatherRequest request;
+        bool taken = false;
+        notEmpty.wait(lock, [this, &request, &taken]
+                      { taken = takeRunnable(request);
+                        return taken || (stopping && queue.empty()); });
+        if (!taken)
+        {
+            return;
+        }
+        lock.unlock();
+
+        try
+        { // The city has to leave busyCities on every path, else its later requests never run
+            handler(request);
+        }
+        catch (const exception &e)
+        {
+            cerr << "Request for city " << request.city << " failed: " << e.what() << endl;
+        }
+        catch (...)
+        {
+            cerr << "Request for city " << request.city << " failed" << endl;
+        }
+
+        lock.lock();
+        busyCities.erase(request.city);
+        // Requests for this city may have been skipped while it was busy
+        notEmpty.notify_all();
+    }
+}
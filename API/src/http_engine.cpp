@@ -0,0 +1,185 @@
+/* Author: Jan Šulák
+ * Description: Long-lived HTTP client running concurrent transfers on one curl_multi event loop with persistent connections.
+ * Date: 9.December 2024
+ */
+
+#include "http_engine.h"
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+// Function to handle HTTP response
+static size_t WriteCallback(void *contents, size_t size, size_t nmemb, string *out)
+{
+    size_t totalSize = size * nmemb;
+    out->append((char *)contents, totalSize);
+    return totalSize;
+}
+
+HttpEngine::HttpEngine(long maxHostConnections)
+{
+    multi = curl_multi_init();
+    if (!multi)
+    {
+        throw runtime_error("Failed to initialize cURL multi handle");
+    }
+    // The multi handle owns the DNS and connection caches shared by all transfers
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxHostConnections);
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, maxHostConnections * 2);
+    loopThread = thread(&HttpEngine::eventLoop, this);
+}
+
+HttpEngine::~HttpEngine()
+{
+    stopping = true;
+    curl_multi_wakeup(multi);
+    loopThread.join();
+
+    for (Transfer *transfer : pending)
+    {
+        transfer->response.error = "HTTP engine stopped";
+        transfer->promise.set_value(move(transfer->response));
+        delete transfer;
+    }
+    for (CURL *easy : idleHandles)
+    {
+        curl_easy_cleanup(easy);
+    }
+    curl_multi_cleanup(multi);
+}
+
+future<HttpResponse> HttpEngine::fetch(const string &url)
+{
+    Transfer *transfer = new Transfer();
+    transfer->url = url;
+    future<HttpResponse> result = transfer->promise.get_future();
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        pending.push_back(transfer);
+    }
+    curl_multi_wakeup(multi);
+    return result;
+}
+
+HttpEngine::Stats HttpEngine::stats() const
+{
+    return Stats{requests.load(), newConnections.load(), failures.load()};
+}
+
+// Function to move the queued transfers into the multi handle
+void HttpEngine::startPending()
+{
+    deque<Transfer *> batch;
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        batch.swap(pending);
+    }
+
+    for (Transfer *transfer : batch)
+    {
+        CURL *easy = nullptr;
+        if (!idleHandles.empty())
+        {
+            easy = idleHandles.back();
+            idleHandles.pop_back();
+            curl_easy_reset(easy);
+        }
+        else
+        {
+            easy = curl_easy_init();
+        }
+        if (!easy)
+        {
+            failures++;
+            transfer->response.error = "Failed to initialize cURL";
+            transfer->promise.set_value(move(transfer->response));
+            delete transfer;
+            continue;
+        }
+
+        transfer->easy = easy;
+        curl_easy_setopt(easy, CURLOPT_URL, transfer->url.c_str());
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response.body);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, 5000L);
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, 10000L);
+        curl_multi_add_handle(multi, easy);
+        activeHandles.insert(easy);
+    }
+}
+
+// Function to fulfill the promise of a finished transfer and keep its handle for reuse
+void HttpEngine::finishTransfer(CURL *easy, CURLcode result)
+{
+    Transfer *transfer = nullptr;
+    curl_easy_getinfo(easy, CURLINFO_PRIVATE, &transfer);
+
+    long connects = 0;
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME, &transfer->response.seconds);
+    transfer->response.reused = (connects == 0);
+    newConnections += connects;
+    requests++;
+
+    if (result == CURLE_OK)
+    {
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &transfer->response.status);
+    }
+    else
+    {
+        failures++;
+        transfer->response.error = curl_easy_strerror(result);
+    }
+
+    curl_multi_remove_handle(multi, easy);
+    activeHandles.erase(easy);
+    idleHandles.push_back(easy);
+
+    transfer->promise.set_value(move(transfer->response));
+    delete transfer;
+}
+
+void HttpEngine::eventLoop()
+{
+    while (!stopping)
+    {
+        startPending();
+
+        int running = 0;
+        CURLMcode code = curl_multi_perform(multi, &running);
+        if (code != CURLM_OK)
+        {
+            cerr << "cURL multi error: " << curl_multi_strerror(code) << endl;
+        }
+
+        int queued = 0;
+        while (CURLMsg *msg = curl_multi_info_read(multi, &queued))
+        {
+            if (msg->msg == CURLMSG_DONE)
+            {
+                finishTransfer(msg->easy_handle, msg->data.result);
+            }
+        }
+
+        // Sleeps until a socket is ready, a timeout expires or fetch() wakes the loop up
+        curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
+
+    // Abort the transfers still running
+    for (CURL *easy : activeHandles)
+    {
+        Transfer *transfer = nullptr;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, &transfer);
+        curl_multi_remove_handle(multi, easy);
+        curl_easy_cleanup(easy);
+        transfer->response.error = "HTTP engine stopped";
+        transfer->promise.set_value(move(transfer->response));
+        delete transfer;
+    }
+    activeHandles.clear();
+}
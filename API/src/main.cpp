@@ -6,11 +6,33 @@
 #include <iostream>
 #include <string>
 #include <curl/curl.h>
-#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
 #include <mqtt/async_client.h>
 #include <map>
-#include <fstream>
+#include <vector>
 #include <csignal>
+#include <thread>
+
+#include "city_catalog.h"
+#include "city_index.h"
+#include "city_registry.h"
+#include "config.h"
+#include "dispatcher.h"
+#include "http_engine.h"
+#include "metrics.h"
+#include "mood_journal.h"
+#include "mood_replica.h"
+#include "prefetcher.h"
+#include "publish_pipeline.h"
+#include "snapshot_tracker.h"
+#include "traffic_trace.h"
+#include "upstream_scheduler.h"
+#include "weather_parser.h"
+#include "weather_payload.h"
+#include "weather_cache.h"
+#include "weather_history.h"
 
 using namespace std;
 
@@ -18,189 +40,614 @@ bool running = true;
 
 const string MQTT_BROKER = ""; // Set the IP address of the MQTT broker
 const string REQUEST_TOPIC = "requests";
+const string BINARY_TOPIC_SUFFIX = "/bin";
+const string HISTORY_TOPIC = "history"; // Requests "seconds [points]" on history/<city>, replies on history/<city>/result
+const string HISTORY_RESULT_SUFFIX = "/result";
+const string MOOD_STATE_TOPIC = "moods"; // Retained "version instance mood" on moods/<city>, replicated between the instances
+const string CITY_LIST_TOPIC = "cities"; // Paged listing, requests "page" or "page query", replies on cities/<page> or cities/<query>/<page>
 string mood = "Neutral";
 
-map<string, string> cityMood = {
-    {"Brno", "Neutral"},
-    {"Prague", "Neutral"},
-    {"Ostrava", "Neutral"},
-    {"Plzen", "Neutral"},
-    {"Liberec", "Neutral"},
-    {"Olomouc", "Neutral"},
-    {"Vienna", "Neutral"},
-    {"Berlin", "Neutral"},
-    {"Paris", "Neutral"},
-    {"London", "Neutral"}};
+// Function to list the featured cities of the shared table with their OpenWeather IDs, listed first and prefetched
+// through the batched group query. They are the only supported cities unless a catalog is configured.
+vector<pair<string, long>> featuredCities()
+{
+    vector<pair<string, long>> cities;
+    for (size_t i = 0; i < FEATURED_CITY_COUNT; ++i)
+    {
+        cities.emplace_back(FEATURED_CITY_NAMES[i], FEATURED_CITY_WEATHER_IDS[i]);
+    }
+    return cities;
+}
 
 const string API_KEY = ""; // Set your OpenWeather API key
 const string DATA_FILE = "data.txt";
 
-// Function to handle HTTP response
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, string *out)
+// Incoming requests and upstream responses, recorded for replays when WEATHER_TRACE_FILE is set
+TraceWriter trace;
+
+// Service metrics, registered before main so the handlers only touch lock-free counters
+MetricsRegistry metrics;
+Counter &requestsTotal = metrics.counter("weather_requests_total", "Requests received on the requests topic");
+Counter &requestsRejected = metrics.counter("weather_requests_rejected_total", "Requests rejected for an unknown city, mood or format");
+Counter &requestsDropped = metrics.counter("weather_requests_dropped_total", "Requests dropped because the worker queue was full");
+Counter &fetchErrors = metrics.counter("weather_errors_total{stage=\"fetch\"}", "Failures by stage");
+Counter &parseErrors = metrics.counter("weather_errors_total{stage=\"parse\"}", "Failures by stage");
+Counter &publishErrors = metrics.counter("weather_errors_total{stage=\"publish\"}", "Failures by stage");
+Counter &upstreamCalls = metrics.counter("weather_upstream_calls_total", "Calls of the OpenWeather API");
+Counter &upstreamReused = metrics.counter("weather_upstream_reused_total", "Calls of the OpenWeather API served on a kept-alive connection");
+Counter &published = metrics.counter("weather_published_total", "Weather updates published to city topics");
+Counter &unchanged = metrics.counter("weather_unchanged_total", "Weather updates not republished because the retained snapshot is current");
+Counter &moodsReplicated = metrics.counter("weather_moods_replicated_total", "Mood changes taken over from other instances");
+Gauge &requestsInFlight = metrics.gauge("weather_requests_in_flight", "Requests currently handled by a worker");
+Gauge &upstreamInFlight = metrics.gauge("weather_upstream_in_flight", "Calls of the OpenWeather API waiting for a response");
+Histogram &queueLatency = metrics.histogram("weather_stage_seconds{stage=\"queue\"}", "Latency of the request stages");
+Histogram &cacheLatency = metrics.histogram("weather_stage_seconds{stage=\"cache\"}", "Latency of the request stages");
+Histogram &upstreamLatency = metrics.histogram("weather_stage_seconds{stage=\"upstream\"}", "Latency of the request stages");
+Histogram &parseLatency = metrics.histogram("weather_stage_seconds{stage=\"parse\"}", "Latency of the request stages");
+Histogram &publishLatency = metrics.histogram("weather_stage_seconds{stage=\"publish\"}", "Latency of the request stages");
+Histogram &historyLatency = metrics.histogram("weather_stage_seconds{stage=\"history\"}", "Latency of the request stages");
+Histogram &journalLatency = metrics.histogram("weather_stage_seconds{stage=\"journal\"}", "Latency of the request stages");
+Histogram &requestLatency = metrics.histogram("weather_request_seconds", "Latency from receiving a request to queueing the reply for publishing");
+Histogram &ackLatency = metrics.histogram("weather_publish_ack_seconds", "Latency from sending a message to its acknowledgement by the broker");
+
+// Function to download an OpenWeather API URL, returns an empty string on failure
+string fetchUpstream(HttpEngine &http, UpstreamScheduler &scheduler, UpstreamScheduler::Priority priority,
+                     chrono::milliseconds maxWait, const Config &config, const string &url, const string &what)
 {
-    size_t totalSize = size * nmemb;
-    out->append((char *)contents, totalSize);
-    return totalSize;
+    if (!scheduler.acquire(priority, maxWait))
+    {
+        cerr << "Upstream quota exhausted, skipping the fetch of " << what << endl;
+        return "";
+    }
+    upstreamCalls.inc();
+    HttpResponse response;
+    {
+        InFlight inFlight(upstreamInFlight);
+        ScopedTimer timer(upstreamLatency);
+        response = http.fetch(url).get();
+    }
+    if (response.reused)
+    {
+        upstreamReused.inc();
+    }
+    if (response.error.empty())
+    {
+        trace.record(TraceRecord::RESPONSE, traceRequestKey(url), response.body, static_cast<uint16_t>(response.status));
+    }
+    if (!response.error.empty())
+    {
+        fetchErrors.inc();
+        cerr << "cURL error: " << response.error << endl;
+        return "";
+    }
+    if (response.status == 429)
+    { // Our bucket drifted from the quota of the API, e.g. another client shares the key
+        scheduler.throttle(config.upstreamBackoff);
+    }
+    if (response.status != 200)
+    {
+        fetchErrors.inc();
+        cerr << "OpenWeather API returned HTTP " << response.status << " for " << what << endl;
+        return "";
+    }
+    return response.body;
 }
 
-// Function to fetch weather data from OpenWeather API
-string fetchWeatherData(const string &city)
+// Function to percent-encode a query parameter, city names contain spaces and non-ASCII letters
+string urlEscape(const string &value)
 {
-    CURL *curl = curl_easy_init();
-    if (!curl)
+    char *escaped = curl_easy_escape(nullptr, value.c_str(), static_cast<int>(value.size()));
+    if (escaped == nullptr)
     {
-        cerr << "Failed to initialize cURL" << endl;
         return "";
     }
+    string result(escaped);
+    curl_free(escaped);
+    return result;
+}
 
-    string response;
-    string url = "http://api.openweathermap.org/data/2.5/weather?q=" + city + "&appid=" + API_KEY + "&units=metric";
+// Function to fetch weather data from OpenWeather API by the OpenWeather ID of the city, a background refresh only takes
+// a token that is free right away
+string fetchWeatherData(HttpEngine &http, UpstreamScheduler &scheduler, const Config &config, const CityRegistry &cities,
+                        const string &city, bool background)
+{
+    CityRegistry::CityId id = cities.find(city);
+    string query;
+    if (id != CityRegistry::UNKNOWN && cities.weatherId(id) != 0)
+    {
+        query = "id=" + to_string(cities.weatherId(id));
+    }
+    else
+    { // Only a city without an ID in the catalog is looked up by name
+        query = "q=" + urlEscape(city);
+    }
+    string url = config.apiUrl + "/weather?" + query + "&appid=" + config.apiKey + "&units=metric";
+    if (background)
+    {
+        return fetchUpstream(http, scheduler, UpstreamScheduler::REFRESH, chrono::milliseconds(0), config, url, "city: " + city);
+    }
+    return fetchUpstream(http, scheduler, UpstreamScheduler::INTERACTIVE, config.upstreamMaxWait, config, url, "city: " + city);
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+// Function to fetch weather data of several cities with one call of the OpenWeather group endpoint
+string fetchGroupWeatherData(HttpEngine &http, UpstreamScheduler &scheduler, const Config &config, const vector<long> &ids)
+{
+    string idList;
+    for (long id : ids)
+    {
+        idList += (idList.empty() ? "" : ",") + to_string(id);
+    }
+    string url = config.apiUrl + "/group?id=" + idList + "&appid=" + config.apiKey + "&units=metric";
+    // Waits for the quota up to one prefetch period, the next round fetches the same cities anyway
+    return fetchUpstream(http, scheduler, UpstreamScheduler::PREFETCH, config.prefetchInterval, config, url, "city group: " + idList);
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK)
+// Function to load city moods from file data.txt and its journal, only the featured cities are stored until their mood changes
+void loadCityMood(CityRegistry &cities, MoodJournal &journal)
+{
+    map<string, string> defaults;
+    for (CityRegistry::CityId id = 0; id < cities.featured(); ++id)
     {
-        cerr << "cURL error: " << curl_easy_strerror(res) << endl;
+        defaults[string(cities.name(id))] = moodName(cities.mood(id));
     }
+    for (const auto &entry : journal.load(defaults))
+    {
+        CityRegistry::CityId id = cities.find(entry.first);
+        Mood mood;
+        if (id != CityRegistry::UNKNOWN && parseMood(entry.second, mood))
+        {
+            cities.setMood(id, mood);
+        }
+        else
+        {
+            cerr << "Ignoring stored mood of unknown city or mood: " << entry.first << " " << entry.second << endl;
+        }
+    }
+}
 
-    curl_easy_cleanup(curl); // Ensure cleanup in all cases
-    return response;
+// Function to encode the reading in the compact binary layout shared with the display
+WeatherPayload binaryPayload(const WeatherReading &reading, Mood mood)
+{
+    WeatherPayload weather;
+    weather.temperatureTenths = static_cast<int16_t>(max(-32768L, min(32767L, lround(reading.temperature * 10.0))));
+    weather.humidity = static_cast<uint8_t>(max(0, min(100, reading.humidity)));
+    weather.mood = static_cast<uint8_t>(mood);
+    weather.timestamp = (reading.fields & WeatherReading::TIMESTAMP) ? static_cast<uint32_t>(reading.timestamp)
+                                                                     : static_cast<uint32_t>(time(nullptr));
+    return weather;
 }
 
-// Function to parse JSON response
-void parseWeatherData(const string &jsonResponse, int &temperature, int &humidity)
+// Everything a fetched reading is handed to
+struct ReadingOutputs
+{
+    PublishPipeline &publisher;
+    SnapshotTracker &snapshots;
+    WeatherHistory &history;
+    bool binary; // Also publish the compact binary payload on <city>/bin
+};
+
+// Function to record the weather of a city in its history and publish it with the mood as retained messages on its topic,
+// and optionally on <city>/bin. Displays read the retained snapshot on subscribe, so an unrequested update (prefetch)
+// is only republished when it changes or its TTL runs out. An explicit request always gets its answer.
+bool publishWeather(ReadingOutputs &outputs, const CityRegistry &cities, CityRegistry::CityId id, const string &weatherData, bool requested)
 {
-    size_t tempPos = jsonResponse.find("\"temp\":");
-    if (tempPos != string::npos)
+    const string city(cities.name(id));
+    Mood mood = cities.mood(id);
+    SnapshotTracker &snapshots = outputs.snapshots;
+    WeatherReading reading;
+    ParseStatus status;
     {
-        istringstream tempStream(jsonResponse.substr(tempPos + 7));
-        tempStream >> temperature;
+        ScopedTimer timer(parseLatency);
+        status = parseWeather(weatherData, reading);
     }
-    else
+    if (status != ParseStatus::OK)
+    {
+        parseErrors.inc();
+        cerr << "Invalid weather data for city " << city << ": " << parseStatusName(status) << endl;
+        return false;
+    }
+    WeatherPayload snapshot = binaryPayload(reading, mood);
+    {
+        ScopedTimer timer(historyLatency);
+        outputs.history.append(cities.weatherId(id), snapshot.timestamp, snapshot.temperatureTenths, snapshot.humidity);
+    }
+    if (!snapshots.claim(id, snapshot, requested))
     {
-        cerr << "Temperature data not found in JSON response" << endl;
+        unchanged.inc();
+        return true;
     }
+    // Construct and send the MQTT message to the city topic, the display shows whole degrees
+    const string payload =
+        "{ \"temperature\": " + to_string(lround(reading.temperature)) +
+        ", \"humidity\": " + to_string(reading.humidity) +
+        ", \"mood\": \"" + moodName(mood) + "\" }";
 
-    size_t humidityPos = jsonResponse.find("\"humidity\":");
-    if (humidityPos != string::npos)
+    // A lost delivery makes the next update go out even if nothing changed
+    auto done = [&snapshots, id](bool delivered)
     {
-        istringstream humidityStream(jsonResponse.substr(humidityPos + 11));
-        humidityStream >> humidity;
+        if (!delivered)
+        {
+            publishErrors.inc();
+            snapshots.reset(id);
+        }
+    };
+
+    ScopedTimer timer(publishLatency); // Includes waiting for room in the publish queue
+    OutgoingMessage message;
+    message.topic = city;
+    message.payload = payload;
+    message.retained = true;
+    message.done = done;
+    if (!outputs.publisher.publish(move(message)))
+    {
+        return false;
     }
-    else
+    cout << "[" << city << "]: " << payload << endl;
+    if (outputs.binary)
     {
-        cerr << "Humidity data not found in JSON response" << endl;
+        uint8_t encoded[WEATHER_PAYLOAD_SIZE];
+        encodeWeatherPayload(snapshot, encoded);
+        OutgoingMessage binaryMessage;
+        binaryMessage.topic = city + BINARY_TOPIC_SUFFIX;
+        binaryMessage.payload.assign(reinterpret_cast<const char *>(encoded), sizeof(encoded));
+        binaryMessage.retained = true;
+        binaryMessage.done = done;
+        outputs.publisher.publish(move(binaryMessage));
     }
+    published.inc();
+    return true;
 }
 
-// Function to load city moods from file data.txt
-void loadCityMood()
+// Function to fetch the weather of the requested city and publish it together with its mood
+void handleRequest(ReadingOutputs &outputs, CityRegistry &cities, WeatherCache &cache, MoodReplica &moods, const WeatherRequest &request)
 {
-    ifstream file(DATA_FILE);
-    if (file.is_open())
+    queueLatency.record(chrono::steady_clock::now() - request.receivedAt);
+    InFlight inFlight(requestsInFlight);
+    const string &city = request.city;
+    CityRegistry::CityId id = cities.find(city);
+    if (id == CityRegistry::UNKNOWN)
     {
-        string city, mood;
-        while (file >> city >> mood)
-        {
-            cityMood[city] = mood;
-        }
-        file.close();
+        return;
     }
-    else // create file if it does not exist and initialize with cityMood data
+    Mood mood;
+    string state;
+    if (parseMood(request.mood, mood))
     {
-        ofstream file(DATA_FILE);
-        if (file.is_open())
-        {
-            for (const auto &entry : cityMood)
-            {
-                file << entry.first << " " << entry.second << endl;
-            }
-            file.close();
+        ScopedTimer timer(journalLatency);
+        if (moods.change(id, mood, state))
+        { // Retained so an instance started later catches up on subscribe
+            OutgoingMessage message;
+            message.topic = MOOD_STATE_TOPIC + "/" + city;
+            message.payload = move(state);
+            message.retained = true;
+            outputs.publisher.publish(move(message));
         }
-        else
+    }
+
+    string weatherData;
+    {
+        ScopedTimer timer(cacheLatency);
+        weatherData = cache.get(city);
+    }
+    if (!weatherData.empty())
+    {
+        if (publishWeather(outputs, cities, id, weatherData, true))
         {
-            cerr << "Failed to create data file: " << DATA_FILE << endl;
+            requestLatency.record(chrono::steady_clock::now() - request.receivedAt);
         }
     }
+    else
+    {
+        cerr << "Failed to fetch weather data for city: " << city << endl;
+    }
+}
+
+// Function to list the featured cities by their OpenWeather ID for the prefetcher
+map<long, string> prefetchCities(const CityRegistry &cities)
+{
+    map<long, string> known;
+    for (CityRegistry::CityId id = 0; id < cities.featured(); ++id)
+    {
+        known[cities.weatherId(id)] = string(cities.name(id));
+    }
+    return known;
+}
+
+// Function to store a prefetched city in the cache and publish it without waiting for a request
+void handlePrefetched(ReadingOutputs &outputs, const CityRegistry &cities, WeatherCache &cache, const string &city, const string &weatherData)
+{
+    cache.put(city, weatherData);
+    CityRegistry::CityId id = cities.find(city);
+    if (id != CityRegistry::UNKNOWN)
+    { // Recorded in the history even while disconnected, the pipeline counts the failed deliveries
+        publishWeather(outputs, cities, id, weatherData, false);
+    }
+}
+
+// Function to format a number with one decimal place for the history reply
+static string oneDecimal(double value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f", value);
+    return buffer;
 }
 
-// Function to save city moods to file
-void saveCityMood()
+// Function to answer a history request "seconds [points]" on history/<city> with min/max/avg over the last
+// seconds and the window downsampled to points buckets of [start, temperature, humidity], null for empty buckets
+void handleHistory(PublishPipeline &publisher, const CityRegistry &cities, WeatherHistory &history, const string &topic, const string &payload)
 {
-    ofstream file(DATA_FILE);
-    if (file.is_open())
+    string city = topic.substr(HISTORY_TOPIC.size() + 1);
+    CityRegistry::CityId id = cities.find(city);
+    long seconds = 86400;
+    long points = 24;
+    if (!payload.empty() && sscanf(payload.c_str(), "%ld %ld", &seconds, &points) < 1)
     {
-        for (const auto &entry : cityMood)
+        seconds = -1;
+    }
+    if (id == CityRegistry::UNKNOWN || seconds <= 0 || points <= 0 || points > 1000)
+    {
+        cerr << "Invalid history request for " << city << ": " << payload << endl;
+        requestsRejected.inc();
+        return;
+    }
+
+    ScopedTimer timer(historyLatency);
+    uint32_t to = static_cast<uint32_t>(time(nullptr));
+    uint32_t from = seconds < static_cast<long>(to) ? to - static_cast<uint32_t>(seconds) : 0;
+    WeatherHistory::Summary summary;
+    history.query(cities.weatherId(id), from, to, static_cast<size_t>(points), summary);
+
+    string reply = "{ \"city\": \"" + city + "\", \"from\": " + to_string(from) + ", \"to\": " + to_string(to) +
+                   ", \"count\": " + to_string(summary.count);
+    if (summary.count > 0)
+    {
+        reply += ", \"temperature\": { \"min\": " + oneDecimal(summary.temperatureMin) + ", \"max\": " + oneDecimal(summary.temperatureMax) +
+                 ", \"avg\": " + oneDecimal(summary.temperatureAvg) + " }, \"humidity\": { \"min\": " + oneDecimal(summary.humidityMin) +
+                 ", \"max\": " + oneDecimal(summary.humidityMax) + ", \"avg\": " + oneDecimal(summary.humidityAvg) + " }, \"series\": [";
+        for (size_t b = 0; b < summary.series.size(); ++b)
         {
-            file << entry.first << " " << entry.second << endl;
+            const WeatherHistory::Bucket &bucket = summary.series[b];
+            reply += (b > 0 ? ", [" : "[") + to_string(bucket.from) + ", " +
+                     (bucket.count > 0 ? oneDecimal(bucket.temperature) + ", " + oneDecimal(bucket.humidity) : "null, null") + "]";
         }
-        file.close();
+        reply += "]";
     }
-    else
+    reply += " }";
+
+    OutgoingMessage message;
+    message.topic = topic + HISTORY_RESULT_SUFFIX;
+    message.payload = reply;
+    publisher.tryPublish(move(message));
+}
+
+// Function to answer a listing request "page" or "page query" with one page of city names.
+// The reply starts with the line "page pageSize total" followed by one name per line.
+void handleCityList(PublishPipeline &publisher, const CityRegistry &cities, const CityIndex &index, size_t pageSize, const string &payload)
+{
+    size_t space = payload.find(' ');
+    string pageText = payload.substr(0, space);
+    string query = space != string::npos ? payload.substr(space + 1) : "";
+    char *end = nullptr;
+    long page = strtol(pageText.c_str(), &end, 10);
+    if (pageText.empty() || *end != '\0' || page < 0 || query.find_first_of("/+#") != string::npos)
     {
-        cerr << "Failed to open data file: " << DATA_FILE << endl;
+        cerr << "Invalid city list request: " << payload << endl;
+        requestsRejected.inc();
+        return;
     }
+
+    vector<CityRegistry::CityId> matches;
+    size_t total = cities.size();
+    if (!query.empty())
+    {
+        matches = index.search(query);
+        total = matches.size();
+    }
+    string reply = to_string(page) + " " + to_string(pageSize) + " " + to_string(total) + "\n";
+    size_t first = static_cast<size_t>(page) <= total / pageSize ? static_cast<size_t>(page) * pageSize : total;
+    for (size_t i = first; i < total && i < first + pageSize; ++i)
+    {
+        CityRegistry::CityId id = query.empty() ? static_cast<CityRegistry::CityId>(i) : matches[i];
+        reply += string(cities.name(id)) + "\n";
+    }
+    string topic = CITY_LIST_TOPIC + "/" + (query.empty() ? "" : query + "/") + to_string(page);
+    OutgoingMessage message;
+    message.topic = topic;
+    message.payload = reply;
+    publisher.tryPublish(move(message));
+}
+
+// Function to split a request "city" or "city mood". Names such as "New York" contain spaces, so the last word
+// is the mood only if it is a known mood and the rest a known city, otherwise the whole payload is the city.
+WeatherRequest parseRequest(const CityRegistry &cities, const string &payload)
+{
+    WeatherRequest request;
+    request.city = payload;
+    size_t space = payload.rfind(' ');
+    Mood mood;
+    if (space != string::npos && parseMood(string_view(payload).substr(space + 1), mood) &&
+        cities.find(string_view(payload).substr(0, space)) != CityRegistry::UNKNOWN)
+    {
+        request.city = payload.substr(0, space);
+        request.mood = payload.substr(space + 1);
+    }
+    return request;
 }
 
 // Callback for handling incoming messages
 class Callback : public virtual mqtt::callback
 {
 private:
-    mqtt::async_client &client; // Reference to the MQTT client
+    PublishPipeline &publisher;
+    const CityRegistry &cities;
+    const CityIndex &index;
+    WeatherHistory &history;
+    MoodReplica &moods;
+    const size_t pageSize;
+    Dispatcher &dispatcher; // Worker pool handling the parsed requests
 
 public:
-    Callback(mqtt::async_client &mqttClient) : client(mqttClient) {}
+    Callback(PublishPipeline &replyPublisher, const CityRegistry &registry, const CityIndex &cityIndex, WeatherHistory &weatherHistory,
+             MoodReplica &moodReplica, size_t listPageSize, Dispatcher &requestDispatcher)
+        : publisher(replyPublisher), cities(registry), index(cityIndex), history(weatherHistory), moods(moodReplica),
+          pageSize(listPageSize), dispatcher(requestDispatcher) {}
 
     void message_arrived(mqtt::const_message_ptr msg) override
     {
         string payload = msg->get_payload();
         cout << "[" << msg->get_topic() << "]: " << payload << endl;
+        if (msg->get_topic().compare(0, MOOD_STATE_TOPIC.size() + 1, MOOD_STATE_TOPIC + "/") == 0)
+        { // Every instance sees every change, including the echo of its own
+            CityRegistry::CityId id = cities.find(msg->get_topic().substr(MOOD_STATE_TOPIC.size() + 1));
+            if (id != CityRegistry::UNKNOWN && moods.apply(id, payload))
+            {
+                moodsReplicated.inc();
+            }
+            return;
+        }
+        trace.record(TraceRecord::MESSAGE, msg->get_topic(), payload);
+        if (msg->get_topic() == CITY_LIST_TOPIC)
+        { // Cheap enough to answer right away, without taking a worker
+            handleCityList(publisher, cities, index, pageSize, payload);
+            return;
+        }
+        if (msg->get_topic().compare(0, HISTORY_TOPIC.size() + 1, HISTORY_TOPIC + "/") == 0)
+        { // Sub-millisecond even over a full ring, answered right away as well
+            handleHistory(publisher, cities, history, msg->get_topic(), payload);
+            return;
+        }
+        requestsTotal.inc();
 
         if (!payload.empty())
         {
-            string city = payload.find(" ") != string::npos ? payload.substr(0, payload.find(" ")) : payload;
-            string mood = payload.find(" ") != string::npos ? payload.substr(payload.find(" ") + 1) : cityMood[city];
-            cityMood[city] = mood;
-
-            string weatherData = fetchWeatherData(city);
-            if (!weatherData.empty())
+            WeatherRequest request = parseRequest(cities, payload);
+            if (cities.find(request.city) == CityRegistry::UNKNOWN)
             {
-                int temperature = 0;
-                int humidity = 0;
-                parseWeatherData(weatherData, temperature, humidity);
-                mood = cityMood[city];
-                // Construct and send the MQTT message to the city topic
-                const string payload =
-                    "{ \"temperature\": " + to_string(temperature) +
-                    ", \"humidity\": " + to_string(humidity) +
-                    ", \"mood\": \"" + mood + "\" }";
-
-                try
-                {
-                    client.publish(city, payload.c_str(), payload.length(), 1, false);
-                    cout << "[" << city << "]: " << payload << endl;
-                    saveCityMood(); // Save updated city moods to file
-                }
-                catch (const mqtt::exception &e)
-                {
-                    cerr << "MQTT publish error: " << e.what() << endl;
-                }
+                cerr << "Unknown city: " << request.city << endl;
+                requestsRejected.inc();
+                return;
             }
-            else
+            // Never waits for a worker, this thread also delivers the acknowledgements the workers wait for
+            string city = request.city;
+            if (!dispatcher.submit(move(request)))
             {
-                cerr << "Failed to fetch weather data for city: " << city << endl;
+                cerr << "Request queue full, dropping request for city: " << city << endl;
+                requestsDropped.inc();
             }
         }
         else
         {
             cerr << "Invalid message format: " << payload << endl;
+            requestsRejected.inc();
         }
     }
 };
 
+// Function to log the cache counters used to tune the TTL
+void logCacheStats(const WeatherCache &cache)
+{
+    WeatherCache::Stats stats = cache.stats();
+    cout << "[cache]: hits=" << stats.hits << " stale=" << stats.staleHits << " misses=" << stats.misses
+         << " coalesced=" << stats.coalesced << " failures=" << stats.failures << endl;
+}
+
+// Function to log the publish window and the broker acknowledgement latency
+void logPublishStats(PublishPipeline &publisher)
+{
+    PublishPipeline::Stats stats = publisher.stats();
+    cout << "[publish]: sent=" << stats.sent << " acked=" << stats.acked << " failed=" << stats.failed
+         << " coalesced=" << stats.coalesced << " dropped=" << stats.dropped << " inFlight=" << stats.inFlight << " pending=" << stats.pending
+         << " ackP50=" << ackLatency.quantile(0.5) / 1000.0 << "ms ackP99=" << ackLatency.quantile(0.99) / 1000.0 << "ms" << endl;
+}
+
+// Delivery results of the messages sent by the publish pipeline, the token travels in the user context
+class DeliveryListener : public virtual mqtt::iaction_listener
+{
+private:
+    PublishPipeline *publisher = nullptr;
+
+public:
+    void attach(PublishPipeline &pipeline) { publisher = &pipeline; }
+
+    void on_success(const mqtt::token &tok) override
+    {
+        publisher->complete(reinterpret_cast<uintptr_t>(tok.get_user_context()), true);
+    }
+
+    void on_failure(const mqtt::token &tok) override
+    {
+        publisher->complete(reinterpret_cast<uintptr_t>(tok.get_user_context()), false);
+    }
+};
+
+// Function to export the state owned by the components created in main, read only when the metrics are rendered
+void registerComponentMetrics(const WeatherCache &cache, Dispatcher &dispatcher, HttpEngine &http, PublishPipeline &publisher,
+                              const UpstreamScheduler &scheduler)
+{
+    const char *classes[] = {"interactive", "refresh", "prefetch"};
+    for (int p = UpstreamScheduler::INTERACTIVE; p < UpstreamScheduler::PRIORITIES; ++p)
+    {
+        string label = string("{class=\"") + classes[p] + "\"}";
+        metrics.gaugeFunction("weather_upstream_waiting" + label, "Upstream calls waiting for a token of the quota", [&scheduler, p]
+                              { return static_cast<double>(scheduler.stats().waiting[p]); });
+        metrics.counterFunction("weather_upstream_granted_total" + label, "Upstream calls let through by the quota", [&scheduler, p]
+                                { return static_cast<double>(scheduler.stats().granted[p]); });
+        metrics.counterFunction("weather_upstream_deferred_total" + label, "Upstream calls skipped for lack of quota", [&scheduler, p]
+                                { return static_cast<double>(scheduler.stats().deferred[p]); });
+    }
+    metrics.counterFunction("weather_upstream_throttled_total", "Rate limit responses of the OpenWeather API", [&scheduler]
+                            { return static_cast<double>(scheduler.stats().throttled); });
+    metrics.gaugeFunction("weather_publish_in_flight", "Messages sent and not yet acknowledged by the broker", [&publisher]
+                          { return static_cast<double>(publisher.stats().inFlight); });
+    metrics.gaugeFunction("weather_publish_pending", "Messages waiting for a free slot of the in-flight window", [&publisher]
+                          { return static_cast<double>(publisher.stats().pending); });
+    metrics.counterFunction("weather_publish_total{result=\"acked\"}", "Messages by delivery result", [&publisher]
+                            { return static_cast<double>(publisher.stats().acked); });
+    metrics.counterFunction("weather_publish_total{result=\"failed\"}", "Messages by delivery result", [&publisher]
+                            { return static_cast<double>(publisher.stats().failed); });
+    metrics.counterFunction("weather_publish_total{result=\"coalesced\"}", "Messages by delivery result", [&publisher]
+                            { return static_cast<double>(publisher.stats().coalesced); });
+    metrics.counterFunction("weather_publish_total{result=\"dropped\"}", "Messages by delivery result", [&publisher]
+                            { return static_cast<double>(publisher.stats().dropped); });
+    metrics.gaugeFunction("weather_queue_depth", "Requests waiting for a worker", [&dispatcher]
+                          { return static_cast<double>(dispatcher.queued()); });
+    metrics.counterFunction("weather_cache_total{result=\"hit\"}", "Cache lookups by result", [&cache]
+                            { return static_cast<double>(cache.stats().hits); });
+    metrics.counterFunction("weather_cache_total{result=\"stale\"}", "Cache lookups by result", [&cache]
+                            { return static_cast<double>(cache.stats().staleHits); });
+    metrics.counterFunction("weather_cache_total{result=\"miss\"}", "Cache lookups by result", [&cache]
+                            { return static_cast<double>(cache.stats().misses); });
+    metrics.counterFunction("weather_cache_total{result=\"coalesced\"}", "Cache lookups by result", [&cache]
+                            { return static_cast<double>(cache.stats().coalesced); });
+    metrics.counterFunction("weather_cache_failures_total", "Upstream fetches of the cache that failed", [&cache]
+                            { return static_cast<double>(cache.stats().failures); });
+    metrics.counterFunction("weather_http_connections_total", "Connections opened to the OpenWeather host", [&http]
+                            { return static_cast<double>(http.stats().newConnections); });
+}
+
+// Function to publish the metrics text, skipped while disconnected so export never blocks on the broker
+void publishMetrics(mqtt::async_client &client, const string &topic, const string &text)
+{
+    if (!client.is_connected())
+    {
+        return;
+    }
+    try
+    {
+        client.publish(topic, text.c_str(), text.length(), 0, false);
+    }
+    catch (const mqtt::exception &e)
+    {
+        cerr << "MQTT metrics publish error: " << e.what() << endl;
+    }
+}
+
+// Function to subscribe through a shared subscription group, so the broker hands each message to one of its instances
+string sharedTopic(const string &group, const string &topic)
+{
+    return group.empty() ? topic : "$share/" + group + "/" + topic;
+}
+
 void signalHandler(int signum)
 {
     cout << "Interrupt signal (" << signum << ") received. Exiting..." << endl;
@@ -210,28 +657,115 @@ void signalHandler(int signum)
 int main()
 {
     signal(SIGINT, signalHandler);
-    loadCityMood(); // Load city moods from file
+    Config config = loadConfig(MQTT_BROKER, API_KEY);
 
-    mqtt::async_client client(MQTT_BROKER, "");
+    auto startupBegin = chrono::steady_clock::now();
+    CityCatalog catalog;
+    if (!config.cityCatalog.empty() && !catalog.load(config.cityCatalog))
+    {
+        return 1;
+    }
+    CityRegistry cities(featuredCities(), catalog);
+    if (cities.duplicates() > 0)
+    {
+        cerr << "Left out " << cities.duplicates() << " catalog cities named like an earlier one" << endl;
+    }
+    CityIndex cityIndex(cities);
+    cout << "Indexed " << cities.size() << " cities in "
+         << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startupBegin).count() << " ms" << endl;
+
+    SnapshotTracker snapshots(cities.size(), config.snapshotTtl);
+    WeatherHistory history(config.historyCities, config.historyPoints);
+    if (!config.historyFile.empty() && !history.open(config.historyFile))
+    {
+        cerr << "Continuing without the weather history" << endl;
+    }
+    if (!config.traceFile.empty() && !trace.open(config.traceFile))
+    {
+        cerr << "Continuing without recording the traffic" << endl;
+    }
+    MoodJournal journal(DATA_FILE, config.journal);
+    loadCityMood(cities, journal); // Load city moods from file
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    HttpEngine http(config.httpConnections);
+    UpstreamScheduler scheduler(config.upstreamRate, config.upstreamBurst, config.upstreamReserve);
+    WeatherCache cache(config.cacheTtl, config.cacheStaleTtl, [&http, &scheduler, &config, &cities](const string &city, bool background)
+                       { return fetchWeatherData(http, scheduler, config, cities, city, background); });
+
+    mqtt::async_client client(config.mqttBroker, "");
     mqtt::connect_options connOpts;
 
-    Callback callback(client);
+    DeliveryListener deliveries;
+    PublishPipeline publisher(config.publishWindow, config.publishQueue, config.publishAckTimeout, ackLatency,
+                              [&client, &deliveries](const OutgoingMessage &message, uint64_t token)
+                              { client.publish(message.topic, message.payload.data(), message.payload.size(), message.qos, message.retained,
+                                               reinterpret_cast<void *>(static_cast<uintptr_t>(token)), deliveries); });
+    deliveries.attach(publisher);
+
+    MoodReplica moods(cities, journal, config.instanceId);
+    ReadingOutputs outputs{publisher, snapshots, history, config.binaryPayload};
+    Dispatcher dispatcher(config.workers, config.queueCapacity, [&outputs, &cities, &cache, &moods](const WeatherRequest &request)
+                          { handleRequest(outputs, cities, cache, moods, request); });
+    Callback callback(publisher, cities, cityIndex, history, moods, config.listPageSize, dispatcher);
     client.set_callback(callback);
 
+    registerComponentMetrics(cache, dispatcher, http, publisher, scheduler);
+    MetricsExporter::Publisher metricsPublisher; // QoS 0 straight to the client, it does not take a slot of the window
+    if (!config.metricsTopic.empty())
+    {
+        metricsPublisher = [&client, &config](const string &text)
+        { publishMetrics(client, config.metricsTopic, text); };
+    }
+    MetricsExporter exporter(metrics, config.metricsInterval, config.metricsFile, metricsPublisher);
+
     try
     {
         client.connect(connOpts)->wait();
-        cout << "Connected to MQTT broker on " << MQTT_BROKER << endl;
+        cout << "Connected to MQTT broker on " << config.mqttBroker << endl;
 
-        client.subscribe(REQUEST_TOPIC, 1)->wait();
+        // The replicated moods first, so the retained state is applied before any request is handled
+        client.subscribe(MOOD_STATE_TOPIC + "/+", 1)->wait();
+        client.subscribe(sharedTopic(config.shareGroup, REQUEST_TOPIC), 1)->wait();
+        client.subscribe(sharedTopic(config.shareGroup, CITY_LIST_TOPIC), 1)->wait();
+        client.subscribe(sharedTopic(config.shareGroup, HISTORY_TOPIC + "/+"), 1)->wait();
+
+        Prefetcher prefetcher(
+            config.prefetchInterval, [&cities]
+            { return prefetchCities(cities); },
+            [&http, &scheduler, &config](const vector<long> &ids)
+            { return fetchGroupWeatherData(http, scheduler, config, ids); },
+            [&outputs, &cities, &cache](const string &city, const string &weatherData)
+            { handlePrefetched(outputs, cities, cache, city, weatherData); });
 
         // Keep the program running to process incoming messages
-        cout << "Waiting for messages on topic [" << REQUEST_TOPIC << "]..." << endl;
+        cout << "Waiting for messages on topic [" << sharedTopic(config.shareGroup, REQUEST_TOPIC) << "] as " << config.instanceId << "..." << endl;
+        auto lastStats = chrono::steady_clock::now();
         while (running)
         {
             this_thread::sleep_for(chrono::milliseconds(100)); // Avoid busy-waiting
+            if (config.statsInterval.count() > 0 && chrono::steady_clock::now() - lastStats >= config.statsInterval)
+            {
+                logCacheStats(cache);
+                logPublishStats(publisher);
+                lastStats = chrono::steady_clock::now();
+            }
+        }
+        logCacheStats(cache);
+        // Graceful cleanup, finish the queued requests and deliver their replies before disconnecting
+        scheduler.stop(); // The prefetcher may wait for a token up to a whole period
+        prefetcher.stop();
+        dispatcher.stop();
+        if (!publisher.flush(config.publishAckTimeout))
+        {
+            cerr << "Some replies were not acknowledged before the shutdown" << endl;
         }
-        // Graceful cleanup
+        publisher.stop();
+        logPublishStats(publisher);
+        journal.stop();
+        trace.close();
+        exporter.stop();
+        exporter.exportNow(); // Final values of this run
         if (client.is_connected())
         {
             client.disconnect()->wait();
@@ -0,0 +1,233 @@
+/* Author: Jan Šulák
+ * Description: Lock-free counters, gauges and log-linear latency histograms with Prometheus text export.
+ * Date: 9.December 2024
+ */
+
+#include "metrics.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+int Histogram::bucketIndex(uint64_t micros)
+{
+    if (micros < static_cast<uint64_t>(SUB_BUCKETS))
+    {
+        return static_cast<int>(micros);
+    }
+    int exponent = 63 - __builtin_clzll(micros);
+    int sub = static_cast<int>((micros >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::bucketLowerBound(int index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return static_cast<uint64_t>(index);
+    }
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t sub = static_cast<uint64_t>(index % SUB_BUCKETS);
+    return (static_cast<uint64_t>(SUB_BUCKETS) + sub) << (exponent - SUB_BUCKET_BITS);
+}
+
+void Histogram::record(uint64_t micros)
+{
+    buckets[bucketIndex(micros)].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+    sum.fetch_add(micros, memory_order_relaxed);
+}
+
+void Histogram::record(chrono::steady_clock::duration elapsed)
+{
+    auto micros = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+    record(static_cast<uint64_t>(micros > 0 ? micros : 0));
+}
+
+uint64_t Histogram::quantile(double q) const
+{
+    uint64_t n = count();
+    if (n == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(n) + 0.5);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i)
+    {
+        seen += buckets[i].load(memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // Middle of the bucket halves the worst-case error
+            uint64_t low = bucketLowerBound(i);
+            uint64_t high = i + 1 < BUCKETS ? bucketLowerBound(i + 1) : low;
+            return low + (high - low) / 2;
+        }
+    }
+    return bucketLowerBound(BUCKETS - 1);
+}
+
+Counter &MetricsRegistry::counter(const string &name, const string &help)
+{
+    lock_guard<mutex> lock(registryMutex);
+    counters.emplace_back();
+    counters.back().name = name;
+    counters.back().help = help;
+    return counters.back().metric;
+}
+
+Gauge &MetricsRegistry::gauge(const string &name, const string &help)
+{
+    lock_guard<mutex> lock(registryMutex);
+    gauges.emplace_back();
+    gauges.back().name = name;
+    gauges.back().help = help;
+    return gauges.back().metric;
+}
+
+Histogram &MetricsRegistry::histogram(const string &name, const string &help)
+{
+    lock_guard<mutex> lock(registryMutex);
+    histograms.emplace_back();
+    histograms.back().name = name;
+    histograms.back().help = help;
+    return histograms.back().metric;
+}
+
+void MetricsRegistry::gaugeFunction(const string &name, const string &help, function<double()> read)
+{
+    lock_guard<mutex> lock(registryMutex);
+    functions.push_back(Function{name, help, "gauge", move(read)});
+}
+
+void MetricsRegistry::counterFunction(const string &name, const string &help, function<double()> read)
+{
+    lock_guard<mutex> lock(registryMutex);
+    functions.push_back(Function{name, help, "counter", move(read)});
+}
+
+// Function to split name{labels} into the metric family name and the label list without braces
+static void splitName(const string &name, string &family, string &labels)
+{
+    size_t brace = name.find('{');
+    family = name.substr(0, brace);
+    labels = brace == string::npos ? "" : name.substr(brace + 1, name.size() - brace - 2);
+}
+
+// Function to write the HELP and TYPE lines once per metric family
+static void writeHeader(ostringstream &out, string &lastFamily, const string &family, const string &help, const string &type)
+{
+    if (family != lastFamily)
+    {
+        out << "# HELP " << family << " " << help << "\n";
+        out << "# TYPE " << family << " " << type << "\n";
+        lastFamily = family;
+    }
+}
+
+string MetricsRegistry::renderPrometheus()
+{
+    lock_guard<mutex> lock(registryMutex);
+    ostringstream out;
+    string family, labels, lastFamily;
+
+    for (const auto &c : counters)
+    {
+        splitName(c.name, family, labels);
+        writeHeader(out, lastFamily, family, c.help, "counter");
+        out << c.name << " " << c.metric.get() << "\n";
+    }
+    for (const auto &g : gauges)
+    {
+        splitName(g.name, family, labels);
+        writeHeader(out, lastFamily, family, g.help, "gauge");
+        out << g.name << " " << g.metric.get() << "\n";
+    }
+    for (const auto &f : functions)
+    {
+        splitName(f.name, family, labels);
+        writeHeader(out, lastFamily, family, f.help, f.type);
+        out << f.name << " " << f.read() << "\n";
+    }
+    for (const auto &h : histograms)
+    {
+        splitName(h.name, family, labels);
+        writeHeader(out, lastFamily, family, h.help, "summary");
+        string prefix = labels.empty() ? "" : labels + ",";
+        for (double q : {0.5, 0.9, 0.99, 0.999})
+        {
+            out << family << "{" << prefix << "quantile=\"" << q << "\"} " << h.metric.quantile(q) / 1e6 << "\n";
+        }
+        string suffix = labels.empty() ? "" : "{" + labels + "}";
+        out << family << "_sum" << suffix << " " << h.metric.sumMicros() / 1e6 << "\n";
+        out << family << "_count" << suffix << " " << h.metric.count() << "\n";
+    }
+    return out.str();
+}
+
+MetricsExporter::MetricsExporter(MetricsRegistry &registry, chrono::seconds interval, string path, Publisher publish)
+    : registry(registry), interval(interval), path(move(path)), publish(move(publish))
+{
+    if (interval.count() > 0)
+    {
+        worker = thread(&MetricsExporter::run, this);
+    }
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    stop();
+}
+
+void MetricsExporter::stop()
+{
+    {
+        lock_guard<mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopSignal.notify_all();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void MetricsExporter::exportNow()
+{
+    string text = registry.renderPrometheus();
+    if (!path.empty())
+    { // Write and rename so a scraper never reads a half-written file
+        string tmpPath = path + ".tmp";
+        {
+            ofstream file(tmpPath);
+            file << text;
+        }
+        if (rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            cerr << "Failed to write metrics file: " << path << endl;
+        }
+    }
+    if (publish)
+    {
+        publish(text);
+    }
+}
+
+void MetricsExporter::run()
+{
+    unique_lock<mutex> lock(stopMutex);
+    while (!stopSignal.wait_for(lock, interval, [this]
+                                { return stopping; }))
+    {
+        lock.unlock();
+        exportNow();
+        lock.lock();
+    }
+}
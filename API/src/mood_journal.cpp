@@ -0,0 +1,252 @@
+/* Author: Jan Šulák
+ * Description: Write-behind persistence of city moods, an append-only journal compacted into the data file snapshot.
+ * Date: 9.December 2024
+ */
+
+#include "mood_journal.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+// Function to write the whole buffer to the file descriptor
+static bool writeAll(int fd, const string &data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Function to read "city<TAB>mood" lines, a line without its newline was torn by a crash and is ignored.
+// Names may contain spaces, a line without a tab is from an older file and split at its last space.
+static size_t readEntries(const string &path, map<string, string> &entries)
+{
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+    {
+        return 0;
+    }
+    stringstream content;
+    content << file.rdbuf();
+    const string data = content.str();
+
+    size_t count = 0;
+    size_t start = 0;
+    size_t end;
+    while ((end = data.find('\n', start)) != string::npos)
+    {
+        string line = data.substr(start, end - start);
+        size_t separator = line.find('\t');
+        if (separator == string::npos)
+        {
+            separator = line.rfind(' ');
+        }
+        if (separator != string::npos && separator > 0 && separator + 1 < line.size() &&
+            line.find_first_of("\t ", separator + 1) == string::npos)
+        {
+            entries[line.substr(0, separator)] = line.substr(separator + 1);
+            count++;
+        }
+        start = end + 1;
+    }
+    return count;
+}
+
+// Function to cut a line torn by a crash off the end of the journal, else the next append would be glued onto it
+static void dropTornLine(const string &path)
+{
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+    {
+        return;
+    }
+    stringstream content;
+    content << file.rdbuf();
+    const string data = content.str();
+    size_t last = data.rfind('\n');
+    size_t complete = last == string::npos ? 0 : last + 1;
+    if (complete < data.size() && truncate(path.c_str(), static_cast<off_t>(complete)) != 0)
+    {
+        cerr << "Failed to drop the torn line of mood journal " << path << ": " << strerror(errno) << endl;
+    }
+}
+
+MoodJournal::MoodJournal(const string &snapshotPath, Options options)
+    : snapshotPath(snapshotPath), journalPath(snapshotPath + ".journal"), options(options)
+{
+}
+
+MoodJournal::~MoodJournal()
+{
+    stop();
+}
+
+map<string, string> MoodJournal::load(const map<string, string> &defaults)
+{
+    state = defaults;
+    bool haveSnapshot = ifstream(snapshotPath).is_open();
+    readEntries(snapshotPath, state);
+    journalEntries = readEntries(journalPath, state);
+    dropTornLine(journalPath); // Also when it is the only line and nothing is compacted below
+
+    if (!haveSnapshot || journalEntries > 0)
+    { // Start from a snapshot with everything replayed and an empty journal
+        compact();
+    }
+
+    journalFd = open(journalPath.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (journalFd < 0)
+    {
+        cerr << "Failed to open mood journal " << journalPath << ": " << strerror(errno) << endl;
+    }
+
+    writer = thread(&MoodJournal::writerLoop, this);
+    return state;
+}
+
+void MoodJournal::record(const string &city, const string &mood)
+{
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        pending.emplace_back(city, mood);
+    }
+    pendingSignal.notify_one();
+}
+
+void MoodJournal::stop()
+{
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        stopping = true;
+    }
+    pendingSignal.notify_one();
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+    if (journalFd >= 0)
+    {
+        close(journalFd);
+        journalFd = -1;
+    }
+}
+
+// Function to append the batch to the journal and make it durable with one fsync
+bool MoodJournal::appendBatch(const vector<pair<string, string>> &batch)
+{
+    string lines;
+    for (const auto &change : batch)
+    {
+        lines += change.first + "\t" + change.second + "\n";
+        state[change.first] = change.second;
+    }
+    if (journalFd < 0 || !writeAll(journalFd, lines) || fdatasync(journalFd) != 0)
+    {
+        cerr << "Failed to append to mood journal " << journalPath << ": " << strerror(errno) << endl;
+        return false;
+    }
+    journalEntries += batch.size();
+    return true;
+}
+
+// Function to replace the snapshot atomically, a crash leaves either the old or the new file
+bool MoodJournal::writeSnapshot()
+{
+    string content;
+    for (const auto &entry : state)
+    {
+        content += entry.first + "\t" + entry.second + "\n";
+    }
+
+    string tmpPath = snapshotPath + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        cerr << "Failed to create data file: " << tmpPath << endl;
+        return false;
+    }
+    bool ok = writeAll(fd, content) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), snapshotPath.c_str()) != 0)
+    {
+        cerr << "Failed to write data file: " << snapshotPath << endl;
+        return false;
+    }
+
+    // The rename itself is durable only once the directory is synced
+    size_t slash = snapshotPath.rfind('/');
+    string directory = slash == string::npos ? "." : snapshotPath.substr(0, slash + 1);
+    int dirFd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd >= 0)
+    {
+        fsync(dirFd);
+        close(dirFd);
+    }
+    return true;
+}
+
+// Function to fold the journal into the snapshot and start a new, empty journal
+void MoodJournal::compact()
+{
+    if (!writeSnapshot())
+    {
+        return; // Keep the journal, it is still needed to recover the moods
+    }
+    if (truncate(journalPath.c_str(), 0) != 0 && errno != ENOENT)
+    {
+        cerr << "Failed to truncate mood journal " << journalPath << ": " << strerror(errno) << endl;
+        return;
+    }
+    journalEntries = 0;
+}
+
+void MoodJournal::writerLoop()
+{
+    unique_lock<mutex> lock(pendingMutex);
+    while (true)
+    {
+        pendingSignal.wait(lock, [this]
+                           { return stopping || !pending.empty(); });
+        // Give later changes a chance to share the fsync, unless enough of them are already queued
+        pendingSignal.wait_for(lock, options.syncInterval, [this]
+                               { return stopping || pending.size() >= options.syncCount; });
+
+        vector<pair<string, string>> batch;
+        batch.swap(pending);
+        bool done = stopping;
+        lock.unlock();
+
+        if (!batch.empty())
+        {
+            appendBatch(batch);
+        }
+        if (journalEntries >= options.compactAfter || (done && journalEntries > 0))
+        {
+            compact();
+        }
+
+        lock.lock();
+        if (done && pending.empty())
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/* Author: Jan Šulák
+ * Description: Mood state replicated between service instances through versioned retained messages.
+ * Date: 9.December 2024
+ */
+
+#include "mood_replica.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+MoodReplica::MoodReplica(CityRegistry &cities, MoodJournal &journal, string instance)
+    : cities(cities), journal(journal), instance(move(instance)), versions(cities.size())
+{
+}
+
+bool MoodReplica::change(CityRegistry::CityId id, Mood mood, string &state)
+{
+    if (id >= versions.size())
+    {
+        return false;
+    }
+    lock_guard<mutex> lock(shardMutexes[id % SHARDS]);
+    if (!cities.setMood(id, mood))
+    {
+        return false;
+    }
+    Version &version = versions[id];
+    version.number++;
+    version.origin = instance;
+    journal.record(string(cities.name(id)), moodName(mood)); // Persisted by the journal writer, off the request path
+    localCount.fetch_add(1, memory_order_relaxed);
+    state = to_string(version.number) + " " + instance + " " + moodName(mood);
+    return true;
+}
+
+bool MoodReplica::apply(CityRegistry::CityId id, string_view state)
+{
+    // "version instance mood"
+    size_t first = state.find(' ');
+    size_t second = first != string_view::npos ? state.find(' ', first + 1) : string_view::npos;
+    if (second == string_view::npos || id >= versions.size())
+    {
+        return false;
+    }
+    string number(state.substr(0, first));
+    char *end = nullptr;
+    uint64_t remote = strtoull(number.c_str(), &end, 10);
+    string_view origin = state.substr(first + 1, second - first - 1);
+    Mood mood;
+    if (end == number.c_str() || *end != '\0' || origin.empty() || !parseMood(state.substr(second + 1), mood))
+    {
+        return false;
+    }
+
+    lock_guard<mutex> lock(shardMutexes[id % SHARDS]);
+    Version &version = versions[id];
+    if (remote < version.number || (remote == version.number && origin <= version.origin))
+    { // Includes the echo of our own change
+        staleCount.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    version.number = remote;
+    version.origin = string(origin);
+    appliedCount.fetch_add(1, memory_order_relaxed);
+    if (!cities.setMood(id, mood))
+    {
+        return false;
+    }
+    journal.record(string(cities.name(id)), moodName(mood));
+    return true;
+}
+
+MoodReplica::Stats MoodReplica::stats() const
+{
+    return Stats{localCount.load(memory_order_relaxed), appliedCount.load(memory_order_relaxed),
+                 staleCount.load(memory_order_relaxed)};
+}
@@ -0,0 +1,107 @@
+/* Author: Jan Šulák
+ * Description: Background refresh of all known cities through the batched OpenWeather group endpoint.
+ * Date: 9.December 2024
+ */
+
+#include "prefetcher.h"
+#include "weather_parser.h"
+
+#include <iostream>
+
+using namespace std;
+
+vector<string> splitGroupResponse(const string &jsonResponse)
+{
+    vector<string_view> views;
+    ParseStatus status = splitWeatherList(jsonResponse, views);
+    if (status == ParseStatus::MALFORMED)
+    {
+        cerr << "Malformed group response" << endl;
+    }
+    else if (status == ParseStatus::MISSING_FIELD)
+    {
+        cerr << "City list not found in group response" << endl;
+    }
+    return vector<string>(views.begin(), views.end());
+}
+
+long weatherObjectId(const string &jsonObject)
+{
+    // Only the top-level "id" is taken, nested objects such as "weather" and "sys" have their own
+    WeatherReading reading;
+    parseWeather(jsonObject, reading);
+    return (reading.fields & WeatherReading::CITY_ID) ? reading.cityId : -1;
+}
+
+Prefetcher::Prefetcher(chrono::seconds interval, CityList cities, GroupFetcher fetchGroup, CityHandler onCity)
+    : interval(interval), cities(move(cities)), fetchGroup(move(fetchGroup)), onCity(move(onCity))
+{
+    if (interval.count() > 0)
+    {
+        worker = thread(&Prefetcher::run, this);
+    }
+}
+
+Prefetcher::~Prefetcher()
+{
+    stop();
+}
+
+void Prefetcher::stop()
+{
+    {
+        lock_guard<mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopSignal.notify_all();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+size_t Prefetcher::refreshAll()
+{
+    map<long, string> known = cities();
+    vector<long> ids;
+    for (const auto &entry : known)
+    {
+        ids.push_back(entry.first);
+    }
+
+    size_t updated = 0;
+    for (size_t first = 0; first < ids.size(); first += GROUP_SIZE)
+    {
+        vector<long> group(ids.begin() + first, ids.begin() + min(first + GROUP_SIZE, ids.size()));
+        string response = fetchGroup(group);
+        if (response.empty())
+        {
+            cerr << "Failed to prefetch a group of " << group.size() << " cities" << endl;
+            continue;
+        }
+        for (const string &object : splitGroupResponse(response))
+        {
+            auto city = known.find(weatherObjectId(object));
+            if (city != known.end())
+            {
+                onCity(city->second, object);
+                updated++;
+            }
+        }
+    }
+    return updated;
+}
+
+void Prefetcher::run()
+{
+    unique_lock<mutex> lock(stopMutex);
+    while (!stopping)
+    {
+        lock.unlock();
+        size_t updated = refreshAll();
+        cout << "[prefetch]: refreshed " << updated << " cities" << endl;
+        lock.lock();
+        stopSignal.wait_for(lock, interval, [this]
+                            { return stopping; });
+    }
+}
@@ -0,0 +1,224 @@
+/* Author: Jan Šulák
+ * Description: Outgoing MQTT messages with a bounded in-flight window, per-topic coalescing and delivery tracking.
+ * Date: 9.December 2024
+ */
+
+#include "publish_pipeline.h"
+
+#include <iostream>
+#include <utility>
+
+using namespace std;
+
+PublishPipeline::PublishPipeline(size_t window, size_t capacity, chrono::milliseconds ackTimeout, Histogram &ackLatency, Sender sender)
+    : window(window > 0 ? window : 1), capacity(capacity > 0 ? capacity : 1), ackTimeout(ackTimeout), ackLatency(ackLatency),
+      sender(move(sender))
+{
+    worker = thread(&PublishPipeline::senderLoop, this);
+}
+
+PublishPipeline::~PublishPipeline()
+{
+    stop();
+}
+
+bool PublishPipeline::publish(OutgoingMessage message)
+{
+    return enqueue(move(message), true);
+}
+
+bool PublishPipeline::tryPublish(OutgoingMessage message)
+{
+    return enqueue(move(message), false);
+}
+
+bool PublishPipeline::enqueue(OutgoingMessage message, bool wait)
+{
+    unique_lock<mutex> lock(pipelineMutex);
+    auto it = pending.find(message.topic);
+    if (it != pending.end())
+    { // Only the latest state of a topic matters, keep the queue position of the older message
+        it->second = move(message);
+        coalesced++;
+        return true;
+    }
+    if (wait)
+    {
+        canQueue.wait(lock, [this]
+                      { return stopping || order.size() < capacity; });
+    }
+    if (stopping)
+    {
+        return false;
+    }
+    if (order.size() >= capacity)
+    {
+        dropped++;
+        function<void(bool)> done = move(message.done);
+        lock.unlock();
+        if (done)
+        {
+            done(false);
+        }
+        return false;
+    }
+    order.push_back(message.topic);
+    pending.emplace(message.topic, move(message));
+    lock.unlock();
+    canSend.notify_one();
+    return true;
+}
+
+void PublishPipeline::complete(uint64_t token, bool delivered)
+{
+    function<void(bool)> done;
+    {
+        lock_guard<mutex> lock(pipelineMutex);
+        auto it = inFlight.find(token);
+        if (it == inFlight.end())
+        {
+            return; // Already expired
+        }
+        if (delivered)
+        {
+            acked++;
+            ackLatency.record(Clock::now() - it->second.sentAt);
+        }
+        else
+        {
+            failed++;
+        }
+        done = move(it->second.done);
+        inFlight.erase(it);
+        if (inFlight.empty() && pending.empty())
+        {
+            drained.notify_all();
+        }
+    }
+    canSend.notify_one();
+    if (done)
+    {
+        done(delivered);
+    }
+}
+
+bool PublishPipeline::flush(chrono::milliseconds timeout)
+{
+    unique_lock<mutex> lock(pipelineMutex);
+    return drained.wait_for(lock, timeout, [this]
+                            { return pending.empty() && inFlight.empty(); });
+}
+
+void PublishPipeline::stop()
+{
+    {
+        lock_guard<mutex> lock(pipelineMutex);
+        stopping = true;
+    }
+    canSend.notify_all();
+    canQueue.notify_all();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+PublishPipeline::Stats PublishPipeline::stats()
+{
+    lock_guard<mutex> lock(pipelineMutex);
+    return Stats{sent, acked, failed, coalesced, dropped, inFlight.size(), order.size()};
+}
+
+// Function to fail the messages not confirmed within the ack timeout, must be called with pipelineMutex held.
+// The callbacks are collected and run by the caller after unlocking.
+void PublishPipeline::expireLocked(Clock::time_point now, deque<pair<function<void(bool)>, bool>> &results)
+{
+    while (!inFlight.empty() && now - inFlight.begin()->second.sentAt >= ackTimeout)
+    {
+        failed++;
+        if (inFlight.begin()->second.done)
+        {
+            results.emplace_back(move(inFlight.begin()->second.done), false);
+        }
+        inFlight.erase(inFlight.begin());
+    }
+    if (inFlight.empty() && pending.empty())
+    {
+        drained.notify_all();
+    }
+}
+
+void PublishPipeline::senderLoop()
+{
+    unique_lock<mutex> lock(pipelineMutex);
+    while (true)
+    {
+        // Wake up for the oldest ack deadline even if nothing else happens
+        auto ready = [this]
+        { return stopping || (!order.empty() && inFlight.size() < window); };
+        if (inFlight.empty())
+        {
+            canSend.wait(lock, ready);
+        }
+        else
+        {
+            canSend.wait_until(lock, inFlight.begin()->second.sentAt + ackTimeout, ready);
+        }
+
+        deque<pair<function<void(bool)>, bool>> results;
+        expireLocked(Clock::now(), results);
+        if (stopping)
+        {
+            // Messages still waiting are dropped, their owners learn about it through done
+            for (auto &entry : pending)
+            {
+                if (entry.second.done)
+                {
+                    results.emplace_back(move(entry.second.done), false);
+                }
+            }
+            pending.clear();
+            order.clear();
+            drained.notify_all();
+            lock.unlock();
+            for (auto &result : results)
+            {
+                result.first(result.second);
+            }
+            return;
+        }
+
+        OutgoingMessage message;
+        uint64_t token = 0;
+        if (!order.empty() && inFlight.size() < window)
+        {
+            auto it = pending.find(order.front());
+            message = move(it->second);
+            pending.erase(it);
+            order.pop_front();
+            token = nextToken++;
+            inFlight[token] = InFlight{Clock::now(), move(message.done)};
+            sent++;
+        }
+        lock.unlock();
+        canQueue.notify_one();
+
+        for (auto &result : results)
+        {
+            result.first(result.second);
+        }
+        if (token != 0)
+        {
+            try
+            {
+                sender(message, token);
+            }
+            catch (const exception &e)
+            {
+                cerr << "Publish to " << message.topic << " failed: " << e.what() << endl;
+                complete(token, false);
+            }
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,48 @@
+/* Author: Jan Šulák
+ * Description: Last published weather snapshot per city, deciding when the retained city topics need republishing.
+ * Date: 9.December 2024
+ */
+
+#include "snapshot_tracker.h"
+
+using namespace std;
+
+SnapshotTracker::SnapshotTracker(size_t cities, chrono::seconds ttl)
+    : slots(new atomic<uint64_t>[cities]), cities(cities), ttl(ttl), start(chrono::steady_clock::now())
+{
+    for (size_t i = 0; i < cities; ++i)
+    {
+        slots[i].store(0, memory_order_relaxed);
+    }
+}
+
+bool SnapshotTracker::claim(size_t city, const WeatherPayload &snapshot, bool force)
+{
+    if (city >= cities)
+    {
+        return true;
+    }
+    uint64_t values = (static_cast<uint64_t>(static_cast<uint16_t>(snapshot.temperatureTenths)) << 16) |
+                      (static_cast<uint64_t>(snapshot.humidity) << 8) | snapshot.mood;
+    uint64_t now = static_cast<uint64_t>(chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - start).count()) + 1;
+    uint64_t next = (values << 32) | (now & 0xFFFFFFFFu);
+
+    uint64_t previous = slots[city].load(memory_order_acquire);
+    do
+    {
+        bool unchanged = previous != 0 && (previous >> 32) == values;
+        if (!force && unchanged && now - (previous & 0xFFFFFFFFu) < static_cast<uint64_t>(ttl.count()))
+        {
+            return false;
+        }
+    } while (!slots[city].compare_exchange_weak(previous, next, memory_order_acq_rel, memory_order_acquire));
+    return true;
+}
+
+void SnapshotTracker::reset(size_t city)
+{
+    if (city < cities)
+    {
+        slots[city].store(0, memory_order_release);
+    }
+}
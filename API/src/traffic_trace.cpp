@@ -0,0 +1,141 @@
+/* Author: Jan Šulák
+ * Description: Compact binary trace of the incoming MQTT messages and upstream HTTP responses, for recording and replaying traffic.
+ * Date: 9.December 2024
+ */
+
+#include "traffic_trace.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+static const char TRACE_MAGIC[8] = {'W', 'T', 'R', 'A', 'C', 'E', '\0', '\1'};
+static const size_t RECORD_HEADER_SIZE = 20;
+
+static void putLittleEndian(uint8_t *out, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint64_t getLittleEndian(const uint8_t *in, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+string traceRequestKey(const string &url)
+{
+    size_t query = url.find('?');
+    size_t path = url.rfind('/', query);
+    string key = url.substr(path == string::npos ? 0 : path);
+    size_t appid = key.find("appid=");
+    if (appid != string::npos)
+    {
+        size_t end = key.find('&', appid);
+        key.erase(appid, end == string::npos ? string::npos : end + 1 - appid);
+        if (!key.empty() && (key.back() == '&' || key.back() == '?'))
+        {
+            key.pop_back();
+        }
+    }
+    return key;
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const string &path)
+{
+    lock_guard<mutex> lock(fileMutex);
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr || fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), file) != sizeof(TRACE_MAGIC))
+    {
+        cerr << "Failed to create the trace file " << path << ": " << strerror(errno) << endl;
+        if (file != nullptr)
+        {
+            fclose(file);
+            file = nullptr;
+        }
+        return false;
+    }
+    start = chrono::steady_clock::now();
+    return true;
+}
+
+void TraceWriter::record(TraceRecord::Kind kind, const string &key, const string &body, uint16_t status)
+{
+    uint64_t micros = static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+    uint8_t header[RECORD_HEADER_SIZE];
+    header[0] = kind;
+    header[1] = 0;
+    putLittleEndian(header + 2, status, 2);
+    putLittleEndian(header + 4, micros, 8);
+    putLittleEndian(header + 12, key.size(), 4);
+    putLittleEndian(header + 16, body.size(), 4);
+
+    // Buffered by stdio and flushed on close, the reader stops at a record cut short by a crash
+    lock_guard<mutex> lock(fileMutex);
+    if (file == nullptr)
+    {
+        return;
+    }
+    fwrite(header, 1, sizeof(header), file);
+    fwrite(key.data(), 1, key.size(), file);
+    fwrite(body.data(), 1, body.size(), file);
+}
+
+void TraceWriter::close()
+{
+    lock_guard<mutex> lock(fileMutex);
+    if (file != nullptr)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+TraceReader::~TraceReader()
+{
+    if (file != nullptr)
+    {
+        fclose(file);
+    }
+}
+
+bool TraceReader::open(const string &path)
+{
+    file = fopen(path.c_str(), "rb");
+    char magic[sizeof(TRACE_MAGIC)];
+    if (file == nullptr || fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0)
+    {
+        cerr << "Not a readable trace file: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool TraceReader::next(TraceRecord &record)
+{
+    uint8_t header[RECORD_HEADER_SIZE];
+    if (file == nullptr || fread(header, 1, sizeof(header), file) != sizeof(header))
+    {
+        return false;
+    }
+    record.kind = static_cast<TraceRecord::Kind>(header[0]);
+    record.status = static_cast<uint16_t>(getLittleEndian(header + 2, 2));
+    record.micros = getLittleEndian(header + 4, 8);
+    record.key.resize(getLittleEndian(header + 12, 4));
+    record.body.resize(getLittleEndian(header + 16, 4));
+    return fread(&record.key[0], 1, record.key.size(), file) == record.key.size() &&
+           fread(&record.body[0], 1, record.body.size(), file) == record.body.size();
+}
@@ -0,0 +1,117 @@
+/* Author: Jan Šulák
+ * Description: Token bucket in front of the OpenWeather API, granting calls by priority within the per-minute quota.
+ * Date: 9.December 2024
+ */
+
+#include "upstream_scheduler.h"
+
+#include <algorithm>
+
+using namespace std;
+
+UpstreamScheduler::UpstreamScheduler(double callsPerMinute, size_t burst, size_t reserve)
+    : tokensPerSecond(callsPerMinute / 60.0), burst(static_cast<double>(max<size_t>(burst, 1))),
+      reserve(static_cast<double>(min(reserve, max<size_t>(burst, 1) - 1))), tokens(this->burst),
+      refilledAt(Clock::now()), pausedUntil(refilledAt)
+{
+}
+
+void UpstreamScheduler::refill(Clock::time_point now)
+{
+    if (now <= refilledAt)
+    { // Still within a throttle pause
+        return;
+    }
+    double elapsed = chrono::duration<double>(now - refilledAt).count();
+    tokens = min(burst, tokens + elapsed * tokensPerSecond);
+    refilledAt = now;
+}
+
+// Function to decide if the call holding the ticket is next in line, must be called with bucketMutex held
+bool UpstreamScheduler::mayTake(Priority priority, uint64_t ticket) const
+{
+    for (int p = INTERACTIVE; p < priority; ++p)
+    {
+        if (!queues[p].empty())
+        {
+            return false;
+        }
+    }
+    double needed = 1.0 + (priority == INTERACTIVE ? 0.0 : reserve);
+    return queues[priority].front() == ticket && tokens >= needed;
+}
+
+bool UpstreamScheduler::acquire(Priority priority, chrono::milliseconds maxWait)
+{
+    if (tokensPerSecond <= 0.0)
+    {
+        lock_guard<mutex> lock(bucketMutex);
+        counters.granted[priority]++;
+        return true;
+    }
+
+    unique_lock<mutex> lock(bucketMutex);
+    Clock::time_point deadline = Clock::now() + maxWait;
+    uint64_t ticket = nextTicket++;
+    queues[priority].push_back(ticket);
+
+    bool granted = false;
+    while (!stopping || priority == INTERACTIVE)
+    {
+        Clock::time_point now = Clock::now();
+        refill(now);
+        if (now >= pausedUntil && mayTake(priority, ticket))
+        {
+            tokens -= 1.0;
+            granted = true;
+            break;
+        }
+        if (now >= deadline)
+        {
+            break;
+        }
+        // Sleep until the next token is due, or until another call leaves the queue
+        double missing = max(0.0, 1.0 + (priority == INTERACTIVE ? 0.0 : reserve) - tokens);
+        Clock::time_point wake = max(pausedUntil, now + chrono::duration_cast<Clock::duration>(chrono::duration<double>(missing / tokensPerSecond)));
+        changed.wait_until(lock, min(wake, deadline));
+    }
+
+    deque<uint64_t> &queue = queues[priority];
+    queue.erase(find(queue.begin(), queue.end(), ticket));
+    (granted ? counters.granted : counters.deferred)[priority]++;
+    lock.unlock();
+    changed.notify_all(); // The next call in line, possibly of a less important class
+    return granted;
+}
+
+void UpstreamScheduler::throttle(chrono::milliseconds pause)
+{
+    {
+        lock_guard<mutex> lock(bucketMutex);
+        tokens = 0.0;
+        pausedUntil = max(pausedUntil, Clock::now() + pause);
+        refilledAt = pausedUntil; // Nothing accumulates during the pause
+        counters.throttled++;
+    }
+    changed.notify_all();
+}
+
+void UpstreamScheduler::stop()
+{
+    {
+        lock_guard<mutex> lock(bucketMutex);
+        stopping = true;
+    }
+    changed.notify_all();
+}
+
+UpstreamScheduler::Stats UpstreamScheduler::stats() const
+{
+    lock_guard<mutex> lock(bucketMutex);
+    Stats stats = counters;
+    for (int p = INTERACTIVE; p < PRIORITIES; ++p)
+    {
+        stats.waiting[p] = queues[p].size();
+    }
+    return stats;
+}
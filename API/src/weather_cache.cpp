@@ -0,0 +1,137 @@
+/* Author: Jan Šulák
+ * Description: Per-city cache of OpenWeather responses with stale-while-revalidate and single-flight fetching.
+ * Date: 9.December 2024
+ */
+
+#include "weather_cache.h"
+
+#include <thread>
+
+using namespace std;
+
+WeatherCache::WeatherCache(chrono::milliseconds ttl, chrono::milliseconds staleTtl, Fetcher fetcher)
+    : ttl(ttl), staleTtl(staleTtl), fetcher(move(fetcher))
+{
+}
+
+WeatherCache::~WeatherCache()
+{
+    // Background refreshes reference the cache, wait for them before it goes away
+    unique_lock<mutex> lock(entriesMutex);
+    refreshesDone.wait(lock, [this]
+                       { return refreshesRunning == 0; });
+}
+
+string WeatherCache::get(const string &city)
+{
+    unique_lock<mutex> lock(entriesMutex);
+    auto found = entries.find(city); // Only a fetch adds an entry, and a failed one removes it again
+    Clock::time_point now = Clock::now();
+
+    if (found != entries.end() && found->second.valid)
+    {
+        Entry &entry = found->second;
+        auto age = now - entry.fetchedAt;
+        if (age < ttl)
+        {
+            hits++;
+            return entry.data;
+        }
+        if (age < ttl + staleTtl)
+        { // Serve the stale data right away and revalidate it in the background
+            staleHits++;
+            if (!entry.inFlight)
+            {
+                refreshInBackground(city);
+            }
+            return entry.data;
+        }
+    }
+
+    if (found != entries.end() && found->second.inFlight)
+    { // Another request is already fetching this city, share its result
+        coalesced++;
+        shared_future<string> pending = found->second.pending;
+        lock.unlock();
+        return pending.get();
+    }
+
+    misses++;
+    promise<string> result;
+    Entry &entry = entries[city];
+    entry.inFlight = true;
+    entry.pending = result.get_future().share();
+    lock.unlock();
+    return fetchAndStore(city, false, result);
+}
+
+void WeatherCache::put(const string &city, const string &data)
+{
+    if (data.empty())
+    {
+        return;
+    }
+    lock_guard<mutex> lock(entriesMutex);
+    Entry &entry = entries[city];
+    entry.data = data;
+    entry.fetchedAt = Clock::now();
+    entry.valid = true;
+}
+
+// Function to fetch the city upstream and publish the result to the cache and all waiting requests
+string WeatherCache::fetchAndStore(const string &city, bool background, promise<string> &result)
+{
+    string data;
+    try
+    {
+        data = fetcher(city, background);
+    }
+    catch (const exception &)
+    { // Counted as a failed fetch, the waiting requests and the entry must not be left hanging
+        data.clear();
+    }
+
+    lock_guard<mutex> lock(entriesMutex);
+    Entry &entry = entries[city];
+    if (!data.empty())
+    {
+        entry.data = data;
+        entry.fetchedAt = Clock::now();
+        entry.valid = true;
+    }
+    else
+    {
+        failures++;
+    }
+    entry.inFlight = false;
+    entry.pending = shared_future<string>();
+    if (!entry.valid)
+    { // Nothing to keep for a city that never fetched, e.g. an unknown name
+        entries.erase(city);
+    }
+    result.set_value(data);
+    return data;
+}
+
+// Function to start a refresh of a stale entry, must be called with entriesMutex held
+void WeatherCache::refreshInBackground(const string &city)
+{
+    auto result = make_shared<promise<string>>();
+    Entry &entry = entries[city];
+    entry.inFlight = true;
+    entry.pending = result->get_future().share();
+    refreshesRunning++;
+
+    thread([this, city, result]
+           {
+               fetchAndStore(city, true, *result);
+               lock_guard<mutex> lock(entriesMutex);
+               refreshesRunning--;
+               refreshesDone.notify_all(); })
+        .detach();
+}
+
+WeatherCache::Stats WeatherCache::stats() const
+{
+    return Stats{hits.load(), staleHits.load(), misses.load(), coalesced.load(), failures.load()};
+}
@@ -0,0 +1,265 @@
+/* Author: Jan Šulák
+ * Description: Memory-mapped columnar ring buffers of past temperature and humidity readings per city.
+ * Date: 9.December 2024
+ */
+
+#include "weather_history.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char HISTORY_MAGIC[8] = {'W', 'H', 'I', 'S', 'T', 'O', 'R', 'Y'};
+static const uint32_t HISTORY_VERSION = 1;
+
+// Function to round a column offset up so the next column stays aligned for vector loads
+static size_t alignUp(size_t offset)
+{
+    return (offset + 63) & ~static_cast<size_t>(63);
+}
+
+WeatherHistory::WeatherHistory(size_t slots, size_t capacity)
+    : slotCount(slots > 0 ? slots : 1), capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+WeatherHistory::~WeatherHistory()
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mappingSize);
+    }
+}
+
+size_t WeatherHistory::fileSize() const
+{
+    size_t points = slotCount * capacity;
+    size_t offset = alignUp(sizeof(Header) + slotCount * sizeof(Slot));
+    offset = alignUp(offset + points * sizeof(uint32_t));
+    offset = alignUp(offset + points * sizeof(int16_t));
+    return offset + points * sizeof(uint8_t);
+}
+
+bool WeatherHistory::open(const string &path)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        cerr << "Failed to open history file: " << path << endl;
+        return false;
+    }
+    size_t size = fileSize();
+    Header expected;
+    memcpy(expected.magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+    expected.version = HISTORY_VERSION;
+    expected.slotCount = static_cast<uint32_t>(slotCount);
+    expected.capacity = capacity;
+
+    Header existing;
+    bool reuse = pread(fd, &existing, sizeof(existing), 0) == static_cast<ssize_t>(sizeof(existing)) &&
+                 memcmp(&existing, &expected, sizeof(Header)) == 0;
+    if (!reuse)
+    { // Truncating to zero first drops old readings laid out for other dimensions, the file stays sparse
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            cerr << "History file " << path << " has other dimensions, starting a new history" << endl;
+        }
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, static_cast<off_t>(size)) != 0 ||
+            pwrite(fd, &expected, sizeof(expected), 0) != static_cast<ssize_t>(sizeof(expected)))
+        {
+            cerr << "Failed to create history file: " << path << endl;
+            close(fd);
+            return false;
+        }
+    }
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        cerr << "Failed to map history file: " << path << endl;
+        return false;
+    }
+    mappingSize = size;
+
+    char *base = static_cast<char *>(mapping);
+    size_t points = slotCount * capacity;
+    size_t offset = alignUp(sizeof(Header) + slotCount * sizeof(Slot));
+    slots = reinterpret_cast<Slot *>(base + sizeof(Header));
+    timestamps = reinterpret_cast<uint32_t *>(base + offset);
+    offset = alignUp(offset + points * sizeof(uint32_t));
+    temperatures = reinterpret_cast<int16_t *>(base + offset);
+    offset = alignUp(offset + points * sizeof(int16_t));
+    humidities = reinterpret_cast<uint8_t *>(base + offset);
+
+    lock_guard<mutex> lock(historyMutex);
+    slotOf.clear();
+    for (size_t s = 0; s < slotCount; ++s)
+    {
+        if (slots[s].weatherId != 0)
+        {
+            slotOf[static_cast<long>(slots[s].weatherId)] = s;
+        }
+    }
+    return true;
+}
+
+bool WeatherHistory::append(long weatherId, uint32_t timestamp, int16_t temperatureTenths, uint8_t humidity)
+{
+    lock_guard<mutex> lock(historyMutex);
+    if (mapping == nullptr || weatherId == 0)
+    {
+        return false;
+    }
+    size_t s;
+    auto it = slotOf.find(weatherId);
+    if (it != slotOf.end())
+    {
+        s = it->second;
+    }
+    else
+    {
+        if (slotOf.size() >= slotCount)
+        {
+            return false;
+        }
+        s = slotOf.size(); // Slots are taken in order and never released
+        slots[s].weatherId = weatherId;
+        slots[s].written = 0;
+        slotOf[weatherId] = s;
+    }
+
+    Slot &slot = slots[s];
+    size_t base = s * capacity;
+    if (slot.written > 0 && timestamps[base + (slot.written - 1) % capacity] >= timestamp)
+    {
+        return false; // The same upstream reading served again from the cache
+    }
+    size_t i = base + slot.written % capacity;
+    timestamps[i] = timestamp;
+    temperatures[i] = temperatureTenths;
+    humidities[i] = humidity;
+    slot.written++; // Last, so a crash mid-append leaves the previous state
+    return true;
+}
+
+bool WeatherHistory::query(long weatherId, uint32_t from, uint32_t to, size_t points, Summary &summary)
+{
+    lock_guard<mutex> lock(historyMutex);
+    auto it = slotOf.find(weatherId);
+    if (mapping == nullptr || it == slotOf.end() || slots[it->second].written == 0)
+    {
+        return false;
+    }
+    const Slot &slot = slots[it->second];
+    size_t base = it->second * capacity;
+    size_t count = static_cast<size_t>(min<uint64_t>(slot.written, capacity));
+    size_t oldest = slot.written > capacity ? static_cast<size_t>(slot.written % capacity) : 0;
+
+    // The ring holds timestamps in ascending order starting at the oldest element, so it consists of at most
+    // two sorted runs, [oldest, capacity) and [0, oldest). Find the window in each and aggregate over it.
+    struct Run
+    {
+        size_t begin;
+        size_t end;
+    };
+    Run runs[2];
+    int runCount = 0;
+    Run whole[2] = {{oldest, oldest == 0 ? count : capacity}, {0, oldest}};
+    for (const Run &run : whole)
+    {
+        const uint32_t *first = timestamps + base + run.begin;
+        const uint32_t *last = timestamps + base + run.end;
+        const uint32_t *lower = lower_bound(first, last, from);
+        const uint32_t *upper = upper_bound(lower, last, to);
+        if (lower < upper)
+        {
+            runs[runCount++] = Run{static_cast<size_t>(lower - timestamps), static_cast<size_t>(upper - timestamps)};
+        }
+    }
+
+    summary = Summary();
+    points = max<size_t>(points, 1);
+    double span = static_cast<double>(to - from) + 1.0;
+    summary.series.resize(points);
+    vector<int64_t> temperatureSums(points, 0);
+    vector<int64_t> humiditySums(points, 0);
+    for (size_t b = 0; b < points; ++b)
+    {
+        summary.series[b].from = from + static_cast<uint32_t>(span * static_cast<double>(b) / static_cast<double>(points));
+    }
+
+    int16_t temperatureMin = INT16_MAX, temperatureMax = INT16_MIN;
+    uint8_t humidityMin = UINT8_MAX, humidityMax = 0;
+    int64_t temperatureSum = 0, humiditySum = 0;
+    for (int r = 0; r < runCount; ++r)
+    {
+        const size_t begin = runs[r].begin;
+        const size_t end = runs[r].end;
+        // Plain loops over the columns, the compiler vectorizes the min/max/sum reductions
+        for (size_t i = begin; i < end; ++i)
+        {
+            temperatureMin = min(temperatureMin, temperatures[i]);
+            temperatureMax = max(temperatureMax, temperatures[i]);
+            temperatureSum += temperatures[i];
+        }
+        for (size_t i = begin; i < end; ++i)
+        {
+            humidityMin = min(humidityMin, humidities[i]);
+            humidityMax = max(humidityMax, humidities[i]);
+            humiditySum += humidities[i];
+        }
+        // Buckets are contiguous ranges of the sorted timestamps, so each one is a binary search away
+        size_t i = begin;
+        for (size_t b = 0; b < points && i < end; ++b)
+        {
+            uint32_t bucketEnd = b + 1 < points ? summary.series[b + 1].from : to;
+            size_t stop = b + 1 < points ? static_cast<size_t>(lower_bound(timestamps + i, timestamps + end, bucketEnd) - timestamps) : end;
+            summary.series[b].count += static_cast<uint32_t>(stop - i);
+            for (; i < stop; ++i)
+            {
+                temperatureSums[b] += temperatures[i];
+                humiditySums[b] += humidities[i];
+            }
+        }
+        summary.count += static_cast<uint32_t>(end - begin);
+        if (summary.first == 0)
+        {
+            summary.first = timestamps[begin];
+        }
+        summary.last = timestamps[end - 1];
+    }
+    if (summary.count == 0)
+    {
+        return true;
+    }
+    summary.temperatureMin = temperatureMin / 10.0;
+    summary.temperatureMax = temperatureMax / 10.0;
+    summary.temperatureAvg = static_cast<double>(temperatureSum) / summary.count / 10.0;
+    summary.humidityMin = humidityMin;
+    summary.humidityMax = humidityMax;
+    summary.humidityAvg = static_cast<double>(humiditySum) / summary.count;
+    for (size_t b = 0; b < points; ++b)
+    {
+        Bucket &bucket = summary.series[b];
+        if (bucket.count > 0)
+        {
+            bucket.temperature = static_cast<double>(temperatureSums[b]) / bucket.count / 10.0;
+            bucket.humidity = static_cast<double>(humiditySums[b]) / bucket.count;
+        }
+    }
+    return true;
+}
+
+size_t WeatherHistory::cities()
+{
+    lock_guard<mutex> lock(historyMutex);
+    return slotOf.size();
+}
@@ -0,0 +1,347 @@
+/* Author: Jan Šulák
+ * Description: Single-pass, allocation-free parser of OpenWeather current weather responses.
+ * Date: 9.December 2024
+ */
+
+#include "weather_parser.h"
+
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace
+{
+    const int MAX_DEPTH = 32;
+
+    // Recursive descent over the whole document, storing the fields of interest as they pass by
+    class Scanner
+    {
+    public:
+        Scanner(string_view json, WeatherReading &reading, vector<string_view> *listItems = nullptr)
+            : json(json), reading(reading), listItems(listItems) {}
+
+        bool parseDocument()
+        {
+            skipSpace();
+            if (!parseValue("", "", 0))
+            {
+                return false;
+            }
+            skipSpace();
+            return pos == json.size();
+        }
+
+    private:
+        string_view json;
+        WeatherReading &reading;
+        vector<string_view> *listItems; // Collects the elements of the top-level "list" array when set
+        size_t pos = 0;
+
+        void skipSpace()
+        {
+            while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\n' || json[pos] == '\r' || json[pos] == '\t'))
+            {
+                ++pos;
+            }
+        }
+
+        bool consume(char c)
+        {
+            skipSpace();
+            if (pos < json.size() && json[pos] == c)
+            {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+
+        // Reads a string and returns its raw contents without the quotes, escapes are left as they are
+        bool parseString(string_view &out)
+        {
+            if (pos >= json.size() || json[pos] != '"')
+            {
+                return false;
+            }
+            size_t start = ++pos;
+            const char *data = json.data();
+            const size_t size = json.size();
+            while (pos < size)
+            {
+                unsigned char c = static_cast<unsigned char>(data[pos]);
+                if (c == '"')
+                {
+                    out = json.substr(start, pos - start);
+                    ++pos;
+                    return true;
+                }
+                if (c == '\\')
+                {
+                    pos += 2;
+                    continue;
+                }
+                if (c < 0x20)
+                {
+                    return false;
+                }
+                ++pos;
+            }
+            return false;
+        }
+
+        bool parseLiteral(string_view literal)
+        {
+            if (json.substr(pos, literal.size()) != literal)
+            {
+                return false;
+            }
+            pos += literal.size();
+            return true;
+        }
+
+        // Function to store a number if its key is one of the fields we extract
+        bool storeNumber(string_view parent, string_view key, const char *first, const char *last)
+        {
+            if (parent == "main")
+            {
+                if (key == "temp")
+                {
+                    return store(first, last, reading.temperature, WeatherReading::TEMP);
+                }
+                if (key == "feels_like")
+                {
+                    return store(first, last, reading.feelsLike, WeatherReading::FEELS_LIKE);
+                }
+                if (key == "humidity")
+                {
+                    return storeRounded(first, last, reading.humidity, WeatherReading::HUMIDITY);
+                }
+                if (key == "pressure")
+                {
+                    return storeRounded(first, last, reading.pressure, WeatherReading::PRESSURE);
+                }
+            }
+            else if (parent == "wind")
+            {
+                if (key == "speed")
+                {
+                    return store(first, last, reading.windSpeed, WeatherReading::WIND_SPEED);
+                }
+                if (key == "deg")
+                {
+                    return storeRounded(first, last, reading.windDeg, WeatherReading::WIND_DEG);
+                }
+            }
+            else if (parent.empty())
+            {
+                if (key == "id")
+                {
+                    return store(first, last, reading.cityId, WeatherReading::CITY_ID);
+                }
+                if (key == "dt")
+                {
+                    return store(first, last, reading.timestamp, WeatherReading::TIMESTAMP);
+                }
+            }
+            return true;
+        }
+
+        template <typename T>
+        bool store(const char *first, const char *last, T &value, WeatherReading::Field field)
+        {
+            from_chars_result result = from_chars(first, last, value);
+            if (result.ec != errc() || result.ptr != last)
+            {
+                return false;
+            }
+            reading.fields |= field;
+            return true;
+        }
+
+        // Integer fields occasionally arrive with a fraction, e.g. "deg":246.5
+        bool storeRounded(const char *first, const char *last, int &value, WeatherReading::Field field)
+        {
+            double number = 0.0;
+            if (!store(first, last, number, field))
+            {
+                return false;
+            }
+            // from_chars yields inf for huge exponents such as 1e999, the cast would be undefined
+            double rounded = round(number);
+            if (!isfinite(rounded) || rounded < numeric_limits<int>::min() || rounded > numeric_limits<int>::max())
+            {
+                reading.fields &= ~field;
+                return false;
+            }
+            value = static_cast<int>(rounded);
+            return true;
+        }
+
+        bool parseDigits()
+        {
+            size_t start = pos;
+            while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9')
+            {
+                ++pos;
+            }
+            return pos > start;
+        }
+
+        // Validates the JSON number grammar, only fields of interest are converted
+        bool parseNumber(string_view parent, string_view key)
+        {
+            size_t start = pos;
+            if (pos < json.size() && json[pos] == '-')
+            {
+                ++pos;
+            }
+            if (!parseDigits())
+            {
+                return false;
+            }
+            if (pos < json.size() && json[pos] == '.')
+            {
+                ++pos;
+                if (!parseDigits())
+                {
+                    return false;
+                }
+            }
+            if (pos < json.size() && (json[pos] == 'e' || json[pos] == 'E'))
+            {
+                ++pos;
+                if (pos < json.size() && (json[pos] == '+' || json[pos] == '-'))
+                {
+                    ++pos;
+                }
+                if (!parseDigits())
+                {
+                    return false;
+                }
+            }
+            return storeNumber(parent, key, json.data() + start, json.data() + pos);
+        }
+
+        bool parseObject(string_view key, int depth)
+        {
+            ++pos; // '{'
+            if (consume('}'))
+            {
+                return true;
+            }
+            do
+            {
+                skipSpace();
+                string_view member;
+                if (!parseString(member) || !consume(':'))
+                {
+                    return false;
+                }
+                skipSpace();
+                if (!parseValue(key, member, depth + 1))
+                {
+                    return false;
+                }
+            } while (consume(','));
+            return consume('}');
+        }
+
+        bool parseArray(bool isList, int depth)
+        {
+            ++pos; // '['
+            if (consume(']'))
+            {
+                return true;
+            }
+            do
+            {
+                skipSpace();
+                size_t start = pos;
+                // Members of objects inside arrays are never fields of interest
+                if (!parseValue("[]", "", depth + 1))
+                {
+                    return false;
+                }
+                if (isList)
+                {
+                    listItems->push_back(json.substr(start, pos - start));
+                }
+            } while (consume(','));
+            return consume(']');
+        }
+
+        // parent is the key of the enclosing object, key is the key of this value
+        bool parseValue(string_view parent, string_view key, int depth)
+        {
+            if (depth > MAX_DEPTH || pos >= json.size())
+            {
+                return false;
+            }
+            switch (json[pos])
+            {
+            case '{':
+                // Only the top-level object has no parent key, nested objects are named by their key
+                return parseObject(depth == 0 ? string_view() : (key.empty() ? string_view("[]") : key), depth);
+            case '[':
+                return parseArray(listItems && depth == 1 && parent.empty() && key == "list", depth);
+            case '"':
+            {
+                string_view ignored;
+                return parseString(ignored);
+            }
+            case 't':
+                return parseLiteral("true");
+            case 'f':
+                return parseLiteral("false");
+            case 'n':
+                return parseLiteral("null");
+            default:
+                return parseNumber(parent, key);
+            }
+        }
+    };
+}
+
+ParseStatus parseWeather(string_view json, WeatherReading &reading)
+{
+    reading = WeatherReading();
+    Scanner scanner(json, reading);
+    if (!scanner.parseDocument())
+    {
+        return ParseStatus::MALFORMED;
+    }
+    if ((reading.fields & WeatherReading::REQUIRED) != WeatherReading::REQUIRED)
+    {
+        return ParseStatus::MISSING_FIELD;
+    }
+    return ParseStatus::OK;
+}
+
+ParseStatus splitWeatherList(string_view json, vector<string_view> &objects)
+{
+    objects.clear();
+    WeatherReading ignored;
+    Scanner scanner(json, ignored, &objects);
+    if (!scanner.parseDocument())
+    {
+        objects.clear();
+        return ParseStatus::MALFORMED;
+    }
+    return objects.empty() ? ParseStatus::MISSING_FIELD : ParseStatus::OK;
+}
+
+const char *parseStatusName(ParseStatus status)
+{
+    switch (status)
+    {
+    case ParseStatus::OK:
+        return "OK";
+    case ParseStatus::MALFORMED:
+        return "malformed JSON";
+    case ParseStatus::MISSING_FIELD:
+        return "missing temperature or humidity";
+    }
+    return "unknown";
+}
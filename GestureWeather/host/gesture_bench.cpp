@@ -0,0 +1,88 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Host benchmark of the gesture-to-screen latency and the framebuffer bytes pushed per gesture, over a scripted session.
+ * Date: 9.December 2024
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "host_platform.h"
+
+struct SwipeCost
+{
+    const char *name;
+    uint64_t count;
+    uint64_t nanos;       // Until the gesture was handled and the first frame pushed
+    uint64_t screenNanos; // Until the final screen, after the reply of a request
+    uint64_t bytes;
+    uint64_t flushes;
+};
+
+int main(int argc, char *argv[])
+{
+    long rounds = argc > 1 ? atol(argv[1]) : 20000;
+    unsigned long replyDelayMs = argc > 2 ? strtoul(argv[2], nullptr, 10) : 0;
+    bool partial = !(argc > 3 && strcmp(argv[3], "full") == 0); // "full" flushes the whole buffer like the stock driver
+    Station station = newStation();
+    FrameBufferDisplay display(partial);
+    ScriptedMqtt client(station, 50, 10, replyDelayMs);
+    // Browse a few cities, open one, change its mood and go back, also walking past the first listing page
+    ScriptedGestures sensor({SWIPE_RIGHT, SWIPE_RIGHT, SWIPE_DOWN, SWIPE_DOWN, SWIPE_RIGHT, SWIPE_UP, SWIPE_UP,
+                             SWIPE_LEFT, SWIPE_DOWN, SWIPE_DOWN, SWIPE_LEFT, SWIPE_UP, SWIPE_UP, SWIPE_RIGHT});
+
+    SwipeCost costs[] = {{"none", 0, 0, 0, 0, 0}, {"up", 0, 0, 0, 0, 0}, {"down", 0, 0, 0, 0, 0}, {"left", 0, 0, 0, 0, 0}, {"right", 0, 0, 0, 0, 0}};
+    startStation(station, client);
+    while (station.prefetchNext >= 0)
+    { // Boot: the retained snapshots, then the prefetch of the first page
+        client.loop();
+        pollStation(station, display, client);
+    }
+    ScriptedGestures peek = sensor;
+    uint64_t requests = 0;
+    uint64_t cacheHits = 0; // Requests with the detail screen already rendered from the cache
+    handleGesture(station, sensor, display, client); // Leave the start screen
+    peek.readSwipe();
+    for (long i = 0; i < rounds; ++i)
+    {
+        Swipe swipe = peek.readSwipe();
+        uint64_t bytesBefore = display.bytesPushed();
+        uint64_t flushesBefore = display.flushes();
+        auto start = std::chrono::steady_clock::now();
+        handleGesture(station, sensor, display, client);
+        auto handled = std::chrono::steady_clock::now();
+        if (station.pending.active)
+        {
+            requests++;
+            cacheHits += station.pending.isBackground ? 1 : 0;
+        }
+        while (station.pending.active || station.pendingPage.active)
+        { // The main loop of the device, until the reply or the page is shown or it timed out
+            client.loop();
+            pollStation(station, display, client);
+        }
+        auto shown = std::chrono::steady_clock::now();
+        SwipeCost &cost = costs[swipe];
+        cost.count++;
+        cost.nanos += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(handled - start).count());
+        cost.screenNanos += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(shown - start).count());
+        cost.bytes += display.bytesPushed() - bytesBefore;
+        cost.flushes += display.flushes() - flushesBefore;
+    }
+
+    printf("%-6s %10s %12s %12s %14s %12s\n", "swipe", "count", "us/gesture", "us/screen", "bytes/gesture", "flushes");
+    for (const SwipeCost &cost : costs)
+    {
+        if (cost.count > 0)
+        {
+            printf("%-6s %10llu %12.2f %12.2f %14.1f %12.2f\n", cost.name, (unsigned long long)cost.count,
+                   cost.nanos / 1000.0 / cost.count, cost.screenNanos / 1000.0 / cost.count, (double)cost.bytes / cost.count,
+                   (double)cost.flushes / cost.count);
+        }
+    }
+    printf("Weather requests: %llu, refreshes behind a cached screen: %llu\n", (unsigned long long)requests, (unsigned long long)cacheHits);
+    printf("MQTT publishes: %llu, final state %d on city %d\n", (unsigned long long)client.published(), station.currentState, station.currentCity);
+    return 0;
+}
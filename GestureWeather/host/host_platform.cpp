@@ -0,0 +1,223 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Date: 9.December 2024
+ */
+
+#include "host_platform.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+HostSerial Serial;
+
+unsigned long millis()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+void FrameBufferDisplay::clearDisplay()
+{
+    memset(buffer, 0, sizeof(buffer));
+}
+
+void FrameBufferDisplay::drawPixel(int16_t x, int16_t y)
+{
+    if (rotation == 2)
+    { // The panel is mounted upside down
+        x = DISPLAY_WIDTH - 1 - x;
+        y = DISPLAY_HEIGHT - 1 - y;
+    }
+    if (x < 0 || x >= DISPLAY_WIDTH || y < 0 || y >= DISPLAY_HEIGHT)
+    {
+        return;
+    }
+    uint8_t &byte = buffer[x + (y / 8) * DISPLAY_WIDTH];
+    uint8_t bit = static_cast<uint8_t>(1 << (y & 7));
+    byte = textColor != 0 ? (byte | bit) : (byte & ~bit);
+}
+
+void FrameBufferDisplay::drawChar(char character)
+{
+    if (character == '\n')
+    {
+        cursorX = 0;
+        cursorY += 8 * textSize;
+        return;
+    }
+    uint8_t code = static_cast<uint8_t>(character);
+    for (int column = 0; column < 5; ++column)
+    {
+        uint8_t line = static_cast<uint8_t>((code * 37u + column * 101u) & 0x7F); // 7 rows of a stand-in glyph
+        for (int row = 0; row < 7; ++row)
+        {
+            if (line & (1 << row))
+            {
+                for (int dx = 0; dx < textSize; ++dx)
+                {
+                    for (int dy = 0; dy < textSize; ++dy)
+                    {
+                        drawPixel(cursorX + column * textSize + dx, cursorY + row * textSize + dy);
+                    }
+                }
+            }
+        }
+    }
+    cursorX += 6 * textSize;
+}
+
+void FrameBufferDisplay::print(const char *text)
+{
+    for (; *text != '\0'; ++text)
+    {
+        drawChar(*text);
+    }
+}
+
+void FrameBufferDisplay::print(int number)
+{
+    print(std::to_string(number).c_str());
+}
+
+void FrameBufferDisplay::print(char character)
+{
+    drawChar(character);
+}
+
+void FrameBufferDisplay::println(const char *text)
+{
+    print(text);
+    drawChar('\n');
+}
+
+void FrameBufferDisplay::getTextBounds(const char *text, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h)
+{ // Single line of the classic font
+    *x1 = x;
+    *y1 = y;
+    *w = static_cast<uint16_t>(strlen(text) * 6 * textSize);
+    *h = static_cast<uint16_t>(8 * textSize);
+}
+
+void FrameBufferDisplay::display()
+{ // The Adafruit driver addresses the whole panel and sends the whole buffer on every call
+    flushCount++;
+    if (partial)
+    {
+        DirtySpan spans[DISPLAY_PAGES];
+        pushedBytes += diff.diff(buffer, spans);
+    }
+    else
+    {
+        pushedBytes += FLUSH_COMMAND_BYTES + sizeof(buffer);
+    }
+}
+
+bool FrameBufferDisplay::pixel(int16_t x, int16_t y) const
+{
+    return x >= 0 && x < DISPLAY_WIDTH && y >= 0 && y < DISPLAY_HEIGHT && (buffer[x + (y / 8) * DISPLAY_WIDTH] & (1 << (y & 7)));
+}
+
+ScriptedMqtt::ScriptedMqtt(Station &station, int totalCities, int pageSize, unsigned long replyDelayMs)
+    : station(station), totalCities(totalCities), pageSize(pageSize), replyDelayMs(replyDelayMs),
+      moods(static_cast<size_t>(totalCities))
+{
+    for (int i = 0; i < totalCities; ++i)
+    { // Mixed moods, so a mood picked on the display usually differs from the stored one
+        moods[i] = static_cast<uint8_t>(i % MOOD_COUNT);
+    }
+}
+
+std::string ScriptedMqtt::cityName(int index) const
+{
+    return index < static_cast<int>(FEATURED_CITY_COUNT) ? FEATURED_CITY_NAMES[index] : "City" + std::to_string(index);
+}
+
+void ScriptedMqtt::queueMessage(const std::string &topic, const std::string &payload)
+{
+    queue.push_back(Message{topic, payload, millis() + replyDelayMs});
+}
+
+void ScriptedMqtt::queueSnapshot(const std::string &city)
+{
+    int index = 0;
+    while (index < totalCities && cityName(index) != city)
+    {
+        index++;
+    }
+    if (index == totalCities)
+    {
+        return;
+    }
+    WeatherPayload weather;
+    weather.temperatureTenths = static_cast<int16_t>((index % 40 - 10) * 10);
+    weather.humidity = static_cast<uint8_t>(index % 100);
+    weather.mood = moods[index];
+    weather.timestamp = 0;
+#ifdef WEATHER_BINARY_PAYLOAD
+    uint8_t encoded[WEATHER_PAYLOAD_SIZE];
+    encodeWeatherPayload(weather, encoded);
+    queueMessage(city + "/bin", std::string(reinterpret_cast<const char *>(encoded), sizeof(encoded)));
+#else
+    queueMessage(city, "{ \"temperature\": " + std::to_string(weather.temperatureTenths / 10) + ", \"humidity\": " +
+                           std::to_string(weather.humidity) + ", \"mood\": \"" + moodName(static_cast<Mood>(weather.mood)) + "\" }");
+#endif
+}
+
+bool ScriptedMqtt::subscribe(const char *topic)
+{
+    std::string name(topic);
+    if (isCityListTopic(topic))
+    {
+        return true;
+    }
+    size_t suffix = name.find('/');
+    queueSnapshot(name.substr(0, suffix)); // Retained snapshot of the city
+    return true;
+}
+
+bool ScriptedMqtt::publish(const char *topic, const char *payload)
+{
+    publishCount++;
+    std::string request(payload);
+    if (strcmp(topic, CITY_LIST_TOPIC) == 0)
+    {
+        int page = atoi(payload);
+        std::string reply = std::to_string(page) + " " + std::to_string(pageSize) + " " + std::to_string(totalCities) + "\n";
+        for (int i = page * pageSize; i < totalCities && i < (page + 1) * pageSize; ++i)
+        {
+            reply += cityName(i) + "\n";
+        }
+        queueMessage(cityListTopic(page), reply);
+    }
+    else if (strcmp(topic, "requests") == 0)
+    {
+        size_t space = request.find(' ');
+        std::string city = request.substr(0, space);
+        Mood mood;
+        if (space != std::string::npos && findMood(request.c_str() + space + 1, request.size() - space - 1, mood))
+        {
+            for (int i = 0; i < totalCities; ++i)
+            {
+                if (cityName(i) == city)
+                {
+                    moods[i] = static_cast<uint8_t>(mood);
+                }
+            }
+        }
+        queueSnapshot(city);
+    }
+    return true;
+}
+
+bool ScriptedMqtt::loop()
+{
+    while (!queue.empty() && static_cast<long>(millis() - queue.front().dueAt) >= 0)
+    {
+        Message message = queue.front();
+        queue.pop_front();
+        handleMessage(station, message.topic.c_str(), reinterpret_cast<const uint8_t *>(message.payload.data()),
+                      static_cast<unsigned int>(message.payload.size()));
+    }
+    return true;
+}
@@ -0,0 +1,122 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Host implementations of the platform interfaces, an in-memory framebuffer, a scripted broker and scripted gestures.
+ * Date: 9.December 2024
+ */
+
+#ifndef HOST_PLATFORM_H
+#define HOST_PLATFORM_H
+
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "render.h"
+#include "station.h"
+
+// 128x64 monochrome framebuffer laid out in pages like the SSD1306 RAM. Text is drawn pixel by pixel in
+// the 6x8 cells of the Adafruit classic font, with a pattern derived from the character instead of the glyph.
+// A flush counts the bytes the panel would receive, only the changed spans when partial like on the device.
+class FrameBufferDisplay : public Display
+{
+public:
+    static const size_t BUFFER_SIZE = DISPLAY_BUFFER_SIZE;
+
+    explicit FrameBufferDisplay(bool partial = true) : partial(partial) {}
+
+    void clearDisplay() override;
+    void setRotation(uint8_t value) override { rotation = value & 3; }
+    void setTextSize(uint8_t size) override { textSize = size > 0 ? size : 1; }
+    void setTextColor(uint16_t color) override { textColor = color; }
+    void setCursor(int16_t x, int16_t y) override
+    {
+        cursorX = x;
+        cursorY = y;
+    }
+    void print(const char *text) override;
+    void print(int number) override;
+    void print(char character) override;
+    void println(const char *text) override;
+    void getTextBounds(const char *text, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) override;
+    void drawFrame(const uint8_t *frame) override { memcpy(buffer, frame, sizeof(buffer)); }
+    bool frameEquals(const uint8_t *frame) override { return memcmp(buffer, frame, sizeof(buffer)) == 0; }
+    void display() override;
+
+    bool pixel(int16_t x, int16_t y) const;
+    uint64_t flushes() const { return flushCount; }
+    uint64_t bytesPushed() const { return pushedBytes; }
+
+private:
+    void drawPixel(int16_t x, int16_t y);
+    void drawChar(char character);
+
+    uint8_t buffer[BUFFER_SIZE] = {};
+    const bool partial;
+    FrameDiff diff;
+    uint8_t rotation = 0;
+    uint8_t textSize = 1;
+    uint16_t textColor = DISPLAY_WHITE;
+    int16_t cursorX = 0;
+    int16_t cursorY = 0;
+    uint64_t flushCount = 0;
+    uint64_t pushedBytes = 0;
+};
+
+// Stands in for the broker and the API: answers city listing requests with pages of generated cities,
+// sends the snapshots on subscribe and republishes a snapshot for every request. Every
+// message is delivered replyDelayMs after it was caused, like a round trip over WiFi.
+class ScriptedMqtt : public MqttLink
+{
+public:
+    ScriptedMqtt(Station &station, int totalCities, int pageSize, unsigned long replyDelayMs = 0);
+
+    bool subscribe(const char *topic) override;
+    bool unsubscribe(const char *) override { return true; }
+    bool publish(const char *topic, const char *payload) override;
+    // Hands the messages that are due to the station
+    bool loop() override;
+
+    uint64_t published() const { return publishCount; }
+
+private:
+    struct Message
+    {
+        std::string topic;
+        std::string payload;
+        unsigned long dueAt;
+    };
+
+    std::string cityName(int index) const;
+    void queueMessage(const std::string &topic, const std::string &payload);
+    void queueSnapshot(const std::string &city);
+
+    Station &station;
+    const int totalCities;
+    const int pageSize;
+    const unsigned long replyDelayMs;
+    std::vector<uint8_t> moods; // Per city, as the API keeps them
+    std::deque<Message> queue;
+    uint64_t publishCount = 0;
+};
+
+// Replays a fixed sequence of swipes, one per call of readSwipe, from the start again at its end
+class ScriptedGestures : public GestureSensor
+{
+public:
+    explicit ScriptedGestures(std::vector<Swipe> script) : script(script) {}
+
+    bool isGestureAvailable() override { return !script.empty(); }
+    Swipe readSwipe() override
+    {
+        Swipe swipe = script[next];
+        next = (next + 1) % script.size();
+        return swipe;
+    }
+
+private:
+    std::vector<Swipe> script;
+    size_t next = 0;
+};
+
+#endif // HOST_PLATFORM_H
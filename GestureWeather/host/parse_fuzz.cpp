@@ -0,0 +1,68 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Fuzz harness of the message parsers, for libFuzzer or as a standalone mutation loop on the host.
+ * Date: 9.December 2024
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "host_platform.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    std::string message(reinterpret_cast<const char *>(data), size);
+    std::string temperature, humidity, mood;
+    parseMessage(message, temperature, humidity, mood);
+    WeatherPayload weather;
+    parseWeatherMessage(message, weather);
+    decodeWeatherPayload(data, size, weather);
+    std::string city;
+    weatherTopicCity(message.c_str(), city);
+    CityPage page = {0, 1, 1, {}, false};
+    if (parseCityPage(reinterpret_cast<const char *>(data), static_cast<unsigned int>(size), page))
+    {
+        hasCity(page, page.page * page.pageSize);
+    }
+    return 0;
+}
+
+#ifndef WEATHER_LIBFUZZER
+// Without libFuzzer, mutate valid messages at random, meant to run under the address sanitizer
+int main(int argc, char *argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    const std::string seeds[] = {
+        "{ \"temperature\": 12, \"humidity\": 45, \"mood\": \"Happy\" }",
+        "{ \"temperature\": -3, \"humidity\": 100, \"mood\": \"Miserable\" }",
+        "0 10 12\nBrno\nPrague\n",
+    };
+    std::mt19937 random(12345);
+    for (long i = 0; i < iterations; ++i)
+    {
+        std::string input = seeds[random() % 3];
+        int mutations = 1 + random() % 4;
+        for (int m = 0; m < mutations && !input.empty(); ++m)
+        {
+            size_t at = random() % input.size();
+            switch (random() % 3)
+            {
+            case 0:
+                input.erase(at, 1 + random() % 8); // Drop characters, e.g. the closing quote
+                break;
+            case 1:
+                input[at] = static_cast<char>(random());
+                break;
+            default:
+                input.resize(at); // Truncate
+                break;
+            }
+        }
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+    }
+    printf("%ld inputs parsed\n", iterations);
+    return 0;
+}
+#endif
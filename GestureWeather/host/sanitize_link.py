@@ -0,0 +1,4 @@
+# Links the fuzz harness with the sanitizer runtimes it is compiled against
+Import("env")
+
+env.Append(LINKFLAGS=["-fsanitize=address,undefined"])
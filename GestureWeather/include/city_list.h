@@ -0,0 +1,34 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Date: 9.December 2024
+ */
+
+#ifndef CITY_LIST_H
+#define CITY_LIST_H
+
+#include <string>
+#include <vector>
+
+#define CITY_LIST_TOPIC "cities"
+#define CITY_LIST_FILTER CITY_LIST_TOPIC "/+" // Replies to every display, the station keeps the page it asked for
+
+// One page of the city listing served by the API, only this page is kept in RAM
+struct CityPage
+{
+    int page;
+    int pageSize;
+    int total; // Cities over all pages
+    std::vector<std::string> names;
+    bool isReceived;
+};
+
+std::string cityListTopic(int page);
+bool isCityListTopic(const char *topic);
+
+// Parses the reply "page pageSize total\nname\nname\n...", returns false for a malformed one
+bool parseCityPage(const char *payload, unsigned int length, CityPage &cities);
+
+bool hasCity(const CityPage &cities, int index);
+const std::string &cityName(const CityPage &cities, int index);
+
+#endif // CITY_LIST_H
@@ -0,0 +1,151 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Lock-free single-producer single-consumer queues carrying gestures and MQTT traffic between the tasks.
+ * Date: 9.December 2024
+ */
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "station.h"
+
+#define MQTT_TOPIC_SIZE 64
+#define MQTT_COMMAND_PAYLOAD_SIZE 64  // "city mood" requests and page numbers
+#define MQTT_MESSAGE_PAYLOAD_SIZE 512 // A page of the city listing, the size of the PubSubClient buffer
+
+// Ring of N slots, one task pushes and another pops without locks. The head is only written by the producer
+// and the tail only by the consumer, the release stores publish the slot contents to the other side.
+template <typename T, size_t N>
+class SpscRing
+{
+public:
+    static_assert((N & (N - 1)) == 0, "the ring size must be a power of two");
+
+    // Returns false if the ring is full
+    bool push(const T &item)
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) == N)
+        {
+            return false;
+        }
+        items[position & (N - 1)] = item;
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the ring is empty
+    bool pop(T &item)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == position)
+        {
+            return false;
+        }
+        item = items[position & (N - 1)];
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+private:
+    T items[N];
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+};
+
+// A swipe with the micros() of the sensor interrupt and of the I2C read
+struct GestureEvent
+{
+    Swipe swipe;
+    uint32_t interruptAt;
+    uint32_t readAt;
+};
+
+// Gestures read by the gesture task, handed to the state machine in the UI task
+class QueuedGestures : public GestureSensor
+{
+public:
+    // Gesture task side, returns false if the UI task fell 16 gestures behind
+    bool push(const GestureEvent &event) { return events.push(event); }
+
+    bool isGestureAvailable() override { return !events.empty(); }
+    Swipe readSwipe() override
+    {
+        if (!events.pop(last))
+        {
+            last = GestureEvent{SWIPE_NONE, 0, 0};
+        }
+        return last.swipe;
+    }
+    // The event of the last readSwipe()
+    const GestureEvent &lastEvent() const { return last; }
+
+private:
+    SpscRing<GestureEvent, 16> events;
+    GestureEvent last = {SWIPE_NONE, 0, 0};
+};
+
+struct MqttCommand
+{
+    enum Kind : uint8_t
+    {
+        SUBSCRIBE,
+        UNSUBSCRIBE,
+        PUBLISH,
+    } kind;
+    char topic[MQTT_TOPIC_SIZE];
+    char payload[MQTT_COMMAND_PAYLOAD_SIZE];
+};
+
+struct MqttMessage
+{
+    char topic[MQTT_TOPIC_SIZE];
+    uint16_t length;
+    uint8_t payload[MQTT_MESSAGE_PAYLOAD_SIZE];
+};
+
+// The MQTT client as the UI task sees it. Subscribes and publishes are queued for the network task, which owns
+// the real client, and the messages it receives are queued back and handed to the station from loop().
+class QueuedLink : public MqttLink
+{
+public:
+    explicit QueuedLink(Station &station) : station(station) {}
+
+    // UI task side, false if the command does not fit or the network task fell behind
+    bool subscribe(const char *topic) override { return command(MqttCommand::SUBSCRIBE, topic, ""); }
+    bool unsubscribe(const char *topic) override { return command(MqttCommand::UNSUBSCRIBE, topic, ""); }
+    bool publish(const char *topic, const char *payload) override { return command(MqttCommand::PUBLISH, topic, payload); }
+    bool loop() override;
+
+    // UI task side, true once after every connect, the UI task then starts the station again
+    bool hasNewSession();
+
+    // Network task side: queues a received message, false if it was dropped
+    bool received(const char *topic, const uint8_t *payload, unsigned int length);
+    // Carries out the queued commands on the client
+    void runCommands(MqttLink &client);
+    // The client connected, the session is clean
+    void connected() { sessions.fetch_add(1, std::memory_order_release); }
+
+    uint32_t dropped() const { return droppedMessages.load(std::memory_order_relaxed); }
+
+private:
+    bool command(MqttCommand::Kind kind, const char *topic, const char *payload);
+
+    Station &station;
+    SpscRing<MqttCommand, 8> commands;
+    SpscRing<MqttMessage, 16> messages; // The retained snapshots of a listing page arrive in one burst
+    MqttCommand outgoing; // Network task
+    MqttMessage incoming; // UI task, too large for a copy on the stack
+    std::atomic<uint32_t> sessions{0};
+    uint32_t startedSessions = 0; // UI task
+    std::atomic<uint32_t> droppedMessages{0};
+};
+
+#endif // EVENT_QUEUE_H
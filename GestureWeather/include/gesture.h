@@ -6,14 +6,64 @@
 #ifndef GESTURE_H
 #define GESTURE_H
 
+#include "city_list.h"
 #include "screen.h"
+#include "weather_cache.h"
 
-void decreaseMood(std::string &mood);
-void increaseMood(std::string &mood);
+#define REQUEST_TIMEOUT_MS 3000     // Show the timeout screen when nothing arrived after this long
+#define PAGE_TIMEOUT_MS 3000        // Stay on the current city when the page of the next one did not arrive
+#define WEATHER_REFRESH_AFTER_S 600 // Ask the API again when the cached reading is older
 
-void upGesture(std::string &message, int &currentState, int &currentCity, Adafruit_SSD1306 &display, PubSubClient &client, std::string &mood, bool &isReceived);
-void downGesture(std::string &message, int &currentState, int &currentCity, Adafruit_SSD1306 &display, PubSubClient &client, std::string &mood, bool &isReceived);
-void leftGesture(int &currentState, int &currentCity, Adafruit_SSD1306 &display, std::string &mood);
-void rightGesture(int &currentState, int &currentCity, Adafruit_SSD1306 &display, std::string &mood);
+// The API publishes each reply as JSON on <city> and in the binary layout on <city>/bin, the station
+// subscribes to the cities of the page in memory and sorts the replies by topic
+#ifdef WEATHER_BINARY_PAYLOAD
+#define WEATHER_TOPIC_SUFFIX "/bin"
+#else
+#define WEATHER_TOPIC_SUFFIX ""
+#endif
+
+// Weather awaited for the detail screen, polled from loop() so gestures are still handled meanwhile
+struct PendingRequest
+{
+    bool active;
+    bool isReceived;   // The weather of the city arrived
+    bool isBackground; // The cached weather is shown, a timeout keeps it on the screen
+    std::string city;  // Name of the awaited city
+    unsigned long startedAt;
+};
+
+// Page of the listing awaited for the city swiped to, polled from loop() like PendingRequest
+struct PendingPage
+{
+    bool active;
+    bool isReceived; // The page arrived and replaced the one in memory
+    int page;
+    int city; // Index of the city to show once its page arrived
+    unsigned long startedAt;
+};
+
+// Returns false if the topic is not the weather of a city, for example the requests of other displays
+bool weatherTopicCity(const char *topic, std::string &cityName);
+std::string weatherTopic(const std::string &cityName);
+// Asks the API for the weather of the city, the reply arrives on the subscription of its page
+void requestWeather(MqttLink &client, const std::string &request);
+// Returns true if the page with the city is in memory, else asks the API for it and waits in pending.
+// The reply arrives on the listing subscription of the network task.
+bool loadCityPage(const CityPage &cities, PendingPage &pending, int index, MqttLink &client);
+// Moves to the awaited city once its page arrived while the city screen is shown, otherwise keeps the current one
+void pollCityPage(PendingPage &pending, const CityPage &cities, int currentState, int &currentCity, Display &display);
+
+void decreaseMood(Mood &mood);
+void increaseMood(Mood &mood);
+
+// Waits for the weather of the city from now on
+void startRequest(PendingRequest &pending, const std::string &city, bool isBackground);
+// Shows the detail screen once the weather arrived and gives up after the timeout
+void pollRequest(PendingRequest &pending, const WeatherPayload &weather, Display &display);
+
+void upGesture(WeatherPayload &weather, const WeatherCache &cache, CityPage &cities, int &currentState, int &currentCity, Display &display, MqttLink &client, Mood &mood, PendingRequest &pending);
+void downGesture(WeatherPayload &weather, const WeatherCache &cache, CityPage &cities, int &currentState, int &currentCity, Display &display, MqttLink &client, Mood &mood, PendingRequest &pending);
+void leftGesture(CityPage &cities, int &currentState, int &currentCity, Display &display, MqttLink &client, Mood &mood, PendingPage &pendingPage);
+void rightGesture(CityPage &cities, int &currentState, int &currentCity, Display &display, MqttLink &client, Mood &mood, PendingPage &pendingPage);
 
 #endif // GESTURE_H
\ No newline at end of file
@@ -0,0 +1,88 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Small interfaces over the display, the MQTT client and the gesture sensor, so the station logic also builds on a host.
+ * Date: 9.December 2024
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+// Host build, the parts of the Arduino core used by the station logic
+#include <sys/types.h>
+
+unsigned long millis();
+
+// Discards the log, the host harnesses report on their own
+class HostSerial
+{
+public:
+    template <typename T>
+    void print(const T &) {}
+    template <typename T>
+    void println(const T &) {}
+    void println() {}
+};
+extern HostSerial Serial;
+#endif
+
+#define DISPLAY_WIDTH 128
+#define DISPLAY_HEIGHT 64
+#define DISPLAY_WHITE 1
+
+// The calls of Adafruit_GFX/Adafruit_SSD1306 the screens use
+class Display
+{
+public:
+    virtual ~Display() {}
+    virtual void clearDisplay() = 0;
+    virtual void setRotation(uint8_t rotation) = 0;
+    virtual void setTextSize(uint8_t size) = 0;
+    virtual void setTextColor(uint16_t color) = 0;
+    virtual void setCursor(int16_t x, int16_t y) = 0;
+    virtual void print(const char *text) = 0;
+    virtual void print(int number) = 0;
+    virtual void print(char character) = 0;
+    virtual void println(const char *text) = 0;
+    virtual void getTextBounds(const char *text, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) = 0;
+    // Copies a whole frame in the SSD1306 page layout into the buffer
+    virtual void drawFrame(const uint8_t *frame) = 0;
+    virtual bool frameEquals(const uint8_t *frame) = 0;
+    // Pushes the buffer to the panel
+    virtual void display() = 0;
+};
+
+// The calls of PubSubClient the station uses, incoming messages are handed to handleMessage() from loop()
+class MqttLink
+{
+public:
+    virtual ~MqttLink() {}
+    virtual bool subscribe(const char *topic) = 0;
+    virtual bool unsubscribe(const char *topic) = 0;
+    virtual bool publish(const char *topic, const char *payload) = 0;
+    virtual bool loop() = 0;
+};
+
+enum Swipe
+{
+    SWIPE_NONE,
+    SWIPE_UP,
+    SWIPE_DOWN,
+    SWIPE_LEFT,
+    SWIPE_RIGHT,
+};
+
+class GestureSensor
+{
+public:
+    virtual ~GestureSensor() {}
+    virtual bool isGestureAvailable() = 0;
+    // SWIPE_NONE for anything but a swipe
+    virtual Swipe readSwipe() = 0;
+};
+
+#endif // PLATFORM_H
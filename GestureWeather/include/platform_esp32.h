@@ -0,0 +1,176 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: The platform interfaces implemented by the SSD1306 display, PubSubClient and the APDS-9960 sensor of the ESP32 board.
+ * Date: 9.December 2024
+ */
+
+#ifndef PLATFORM_ESP32_H
+#define PLATFORM_ESP32_H
+
+#include <SPI.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+#include <PubSubClient.h>
+#include <SparkFun_APDS9960.h>
+#include <Wire.h>
+
+#include "platform.h"
+#include "render.h"
+
+// Adafruit_SSD1306 that can send the changed columns of each page instead of the whole buffer
+class PartialSsd1306 : public Adafruit_SSD1306
+{
+public:
+    using Adafruit_SSD1306::Adafruit_SSD1306;
+
+    // Sends what changed since the last frame the diff saw, returns the bytes put on the bus
+    size_t displayChanged(FrameDiff &diff)
+    {
+        DirtySpan spans[DISPLAY_PAGES];
+        size_t bytes = diff.diff(getBuffer(), spans);
+        if (wire != nullptr)
+        { // Over I2C every transfer carries its own address, send the whole buffer as usual. The diff still runs to
+          // stay in step with the panel.
+            display();
+            return FLUSH_COMMAND_BYTES + DISPLAY_BUFFER_SIZE;
+        }
+        if (spi != nullptr)
+        {
+            spi->beginTransaction(spiSettings);
+        }
+        digitalWrite(csPin, LOW);
+        for (int page = 0; page < DISPLAY_PAGES; ++page)
+        {
+            const DirtySpan &span = spans[page];
+            if (!span.dirty)
+            {
+                continue;
+            }
+            digitalWrite(dcPin, LOW); // Address window of the span, the panel is in horizontal addressing mode
+            writeByte(SSD1306_PAGEADDR);
+            writeByte(page);
+            writeByte(page);
+            writeByte(SSD1306_COLUMNADDR);
+            writeByte(span.first);
+            writeByte(span.last);
+            digitalWrite(dcPin, HIGH);
+            const uint8_t *row = getBuffer() + page * DISPLAY_WIDTH;
+            for (int column = span.first; column <= span.last; ++column)
+            {
+                writeByte(row[column]);
+            }
+        }
+        digitalWrite(csPin, HIGH);
+        if (spi != nullptr)
+        {
+            spi->endTransaction();
+        }
+        return bytes;
+    }
+
+private:
+    void writeByte(uint8_t value)
+    {
+        if (spi != nullptr)
+        {
+            spi->transfer(value);
+            return;
+        }
+        for (uint8_t bit = 0x80; bit; bit >>= 1)
+        { // Software SPI, the same way the library clocks it out
+            digitalWrite(mosiPin, (value & bit) ? HIGH : LOW);
+            digitalWrite(clkPin, HIGH);
+            digitalWrite(clkPin, LOW);
+        }
+    }
+};
+
+class Ssd1306Display : public Display
+{
+public:
+    explicit Ssd1306Display(PartialSsd1306 &panel) : panel(panel) {}
+
+    void clearDisplay() override { panel.clearDisplay(); }
+    void setRotation(uint8_t rotation) override { panel.setRotation(rotation); }
+    void setTextSize(uint8_t size) override
+    {
+        textSize = size;
+        panel.setTextSize(size);
+    }
+    void setTextColor(uint16_t color) override { panel.setTextColor(color); }
+    void setCursor(int16_t x, int16_t y) override { panel.setCursor(x, y); }
+    void print(const char *text) override { panel.print(text); }
+    void print(int number) override { panel.print(number); }
+    void print(char character) override { panel.print(character); }
+    void println(const char *text) override { panel.println(text); }
+    void getTextBounds(const char *text, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) override
+    { // The rotation stays the same, so the bounds only depend on the text, its size and the position
+        if (!metrics.find(text, textSize, x, y, x1, y1, w, h))
+        {
+            panel.getTextBounds(text, x, y, x1, y1, w, h);
+            metrics.store(text, textSize, x, y, *x1, *y1, *w, *h);
+        }
+    }
+    void drawFrame(const uint8_t *frame) override
+    { // Flash is memory-mapped on the ESP32, PROGMEM data reads like RAM
+        memcpy(panel.getBuffer(), frame, DISPLAY_BUFFER_SIZE);
+    }
+    bool frameEquals(const uint8_t *frame) override { return memcmp(panel.getBuffer(), frame, DISPLAY_BUFFER_SIZE) == 0; }
+    void display() override
+    {
+        unsigned long start = micros();
+        lastFlushBytes = panel.displayChanged(diff);
+        lastFlushMicros = micros() - start;
+    }
+    size_t lastFlushBytes = 0;
+    unsigned long lastFlushMicros = 0;
+
+private:
+    PartialSsd1306 &panel;
+    FrameDiff diff;
+    TextMetricsCache metrics;
+    uint8_t textSize = 1;
+};
+
+class PubSubLink : public MqttLink
+{
+public:
+    explicit PubSubLink(PubSubClient &client) : client(client) {}
+
+    bool subscribe(const char *topic) override { return client.subscribe(topic); }
+    bool unsubscribe(const char *topic) override { return client.unsubscribe(topic); }
+    bool publish(const char *topic, const char *payload) override { return client.publish(topic, payload); }
+    bool loop() override { return client.loop(); }
+
+private:
+    PubSubClient &client;
+};
+
+class Apds9960Sensor : public GestureSensor
+{
+public:
+    explicit Apds9960Sensor(SparkFun_APDS9960 &apds) : apds(apds) {}
+
+    bool isGestureAvailable() override { return apds.isGestureAvailable(); }
+    Swipe readSwipe() override
+    {
+        switch (apds.readGesture())
+        {
+        case DIR_UP:
+            return SWIPE_UP;
+        case DIR_DOWN:
+            return SWIPE_DOWN;
+        case DIR_LEFT:
+            return SWIPE_LEFT;
+        case DIR_RIGHT:
+            return SWIPE_RIGHT;
+        default:
+            return SWIPE_NONE;
+        }
+    }
+
+private:
+    SparkFun_APDS9960 &apds;
+};
+
+#endif // PLATFORM_ESP32_H
@@ -0,0 +1,72 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Render helpers of the display adapters, diffing frames against the last flushed one and caching text metrics.
+ * Date: 9.December 2024
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform.h"
+
+#define DISPLAY_PAGES (DISPLAY_HEIGHT / 8)
+#define DISPLAY_BUFFER_SIZE (DISPLAY_WIDTH * DISPLAY_PAGES)
+#define FLUSH_COMMAND_BYTES 6 // PAGEADDR start end, COLUMNADDR start end
+
+// Changed columns of one SSD1306 page, 8 rows of pixels stored one byte per column
+struct DirtySpan
+{
+    bool dirty;
+    uint8_t first;
+    uint8_t last;
+};
+
+// Remembers the frame last sent to the panel, so a flush sends only the columns that changed in each page
+class FrameDiff
+{
+public:
+    // Fills the spans of the pages that differ from the last flushed frame and takes the frame as flushed.
+    // Returns the bytes to put on the bus, the commands included. Every page is dirty before the first flush.
+    size_t diff(const uint8_t *frame, DirtySpan spans[DISPLAY_PAGES]);
+
+private:
+    uint8_t flushed[DISPLAY_BUFFER_SIZE];
+    bool valid = false;
+};
+
+// Direct-mapped cache of text bounds by the text, the text size and the position
+class TextMetricsCache
+{
+public:
+    bool find(const char *text, uint8_t size, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h);
+    void store(const char *text, uint8_t size, int16_t x, int16_t y, int16_t x1, int16_t y1, uint16_t w, uint16_t h);
+
+private:
+    static const size_t SLOTS = 16;
+
+    // Two independent hashes and the length, a collision of one hash alone would draw with the bounds of another text
+    struct Key
+    {
+        uint32_t hash; // 0 for an empty slot
+        uint32_t check;
+        uint16_t length;
+    };
+
+    struct Entry
+    {
+        Key key;
+        int16_t x1;
+        int16_t y1;
+        uint16_t w;
+        uint16_t h;
+    };
+
+    static Key keyOf(const char *text, uint8_t size, int16_t x, int16_t y);
+
+    Entry entries[SLOTS] = {};
+};
+
+#endif // RENDER_H
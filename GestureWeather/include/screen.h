@@ -6,14 +6,12 @@
 #ifndef SCREEN_H
 #define SCREEN_H
 
-#include <SPI.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
-#include <PubSubClient.h>
-#include <Wire.h>
 #include <string>
 #include <vector>
 
+#include "platform.h"
+#include "weather_payload.h"
+
 enum states
 {
   START_STATE,
@@ -22,12 +20,22 @@ enum states
   MOOD_STATE
 };
 
-void parseMessage(std::string &message, std::string &temperature, std::string &humidity, std::string &mood);
-int16_t getCenteredPosition(Adafruit_SSD1306 &display, std::string item);
+// Splits the JSON reply {"temperature": 12, "humidity": 45, "mood": "Happy"}, returns false for a malformed one
+bool parseMessage(const std::string &message, std::string &temperature, std::string &humidity, std::string &mood);
+bool parseWeatherMessage(const std::string &message, WeatherPayload &weather);
+int16_t getCenteredPosition(Display &display, const char *item);
+
+// Draws each pre-rendered screen through GFX and compares, a difference turns the pre-rendered screens off.
+// Returns the number of screens that differ, 0 also when the build has none.
+int checkPrerenderedScreens(Display &display);
 
-void showStartupScreen(Adafruit_SSD1306 &display);
-void showCityScreen(Adafruit_SSD1306 &display, std::string city);
-void showDetailScreen(std::string &message, Adafruit_SSD1306 &display);
-void showMoodScreen(std::string &mood, Adafruit_SSD1306 &display);
+void showStartupScreen(Display &display);
+void showCityScreen(Display &display, std::string city);
+// ageSeconds of weather shown from the cache, 0 for a fresh reply
+void showDetailScreen(const WeatherPayload &weather, Display &display, unsigned long ageSeconds);
+void showMoodScreen(Mood mood, Display &display);
+// Blank screen shown while the weather of a city is on its way
+void showLoadingScreen(Display &display);
+void showTimeoutScreen(Display &display);
 
 #endif // SCREEN_H
\ No newline at end of file
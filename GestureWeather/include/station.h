@@ -0,0 +1,51 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: State machine of the station, driven by gestures and MQTT messages through the platform interfaces.
+ * Date: 9.December 2024
+ */
+
+#ifndef STATION_H
+#define STATION_H
+
+#include "gesture.h"
+
+#define PREFETCH_DELAY_MS 1000 // Once a page is followed, let its retained snapshots arrive before asking the API for the rest
+#define FOLLOW_PER_POLL 4       // Weather subscribes per poll, the retained replies come in small bursts
+
+// Everything the station remembers between gestures
+struct Station
+{
+    int currentState;
+    int currentCity;
+    PendingRequest pending;
+    PendingPage pendingPage;
+    WeatherPayload weather; // Of the city on the detail screen
+    WeatherCache cache;
+    CityPage cities;
+    Mood mood;
+    int prefetchNext;          // Next city of the page to prefetch, -1 when done
+    unsigned long prefetchAt;  // millis() to start prefetching at, set when the page is followed
+    bool isStarted;            // startStation() ran, the subscriptions follow the page in memory
+    int followedPage;          // Page whose cities are all subscribed, -1 while that is still under way
+    std::vector<std::string> followed; // Cities whose weather topics are subscribed
+};
+
+// Start screen state with the featured cities of the API, shown until the first page of the listing arrives
+Station newStation();
+
+// Subscribes to the weather of the cities on the page in memory and schedules their prefetch, so does every new
+// page later. Call it again after every reconnect, the session starts with no subscriptions.
+void startStation(Station &station, MqttLink &client);
+
+// Handles a message of a subscribed topic, a city page or the weather of a city. A page replaces the one in
+// memory only if the station waits for it or it is the same page. The weather goes to the cache under the
+// city of the topic and to the detail screen only if the station waits for that city.
+void handleMessage(Station &station, const char *topic, const uint8_t *payload, unsigned int length);
+
+// Reads the gesture from the sensor and moves the state machine
+void handleGesture(Station &station, GestureSensor &sensor, Display &display, MqttLink &client);
+
+// Moves a pending request, a pending page, the subscriptions and the prefetch on, call it from every loop()
+void pollStation(Station &station, Display &display, MqttLink &client);
+
+#endif // STATION_H
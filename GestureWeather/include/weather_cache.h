@@ -0,0 +1,57 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Fixed-size cache of the latest weather per city, so a revisited city is shown before its reply arrives.
+ * Date: 9.December 2024
+ */
+
+#ifndef WEATHER_CACHE_H
+#define WEATHER_CACHE_H
+
+#include <string>
+
+#include "weather_payload.h"
+
+#define WEATHER_CACHE_SLOTS 16
+
+struct CachedWeather
+{
+    uint32_t city;       // cityKey() of the name, 0 for a free slot
+    uint32_t check;      // cityCheck() of the name, tells apart the cities whose keys collide
+    uint32_t receivedAt; // millis() when it arrived
+    WeatherPayload weather;
+};
+static_assert(sizeof(CachedWeather) == 20, "keep the cache entries compact");
+
+// 320 bytes of RAM, the least recently received city is replaced when it is full
+struct WeatherCache
+{
+    CachedWeather slots[WEATHER_CACHE_SLOTS];
+};
+
+// Cities are looked up by two independent hashes of the name instead of the name, the listing holds only one page
+// of names in RAM and a copy of each would take most of the cache
+inline uint32_t cityKey(const std::string &cityName)
+{
+    uint32_t key = tableHash(cityName.c_str(), cityName.length(), 0);
+    return key != 0 ? key : 1;
+}
+
+// djb2 over the name and its length, unrelated to the FNV-1a of cityKey()
+inline uint32_t cityCheck(const std::string &cityName)
+{
+    uint32_t check = 5381;
+    for (char character : cityName)
+    {
+        check = check * 33 + static_cast<uint8_t>(character);
+    }
+    return check * 33 + static_cast<uint32_t>(cityName.length());
+}
+
+void clearWeatherCache(WeatherCache &cache);
+// Returns the cached weather of the city or nullptr
+const CachedWeather *findWeather(const WeatherCache &cache, const std::string &cityName);
+// Stores the weather of the city. Without evict it only updates a cached city or takes a free slot,
+// so a burst of cities nobody looks at does not push out the ones in use.
+void storeWeather(WeatherCache &cache, const std::string &cityName, const WeatherPayload &weather, unsigned long now, bool evict);
+
+#endif // WEATHER_CACHE_H
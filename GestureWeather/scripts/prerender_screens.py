@@ -0,0 +1,239 @@
+# Author: Jan Šulák
+# Project: Display MQTT weather station
+# Description: Pre-renders the static screens into 1-bpp SSD1306 frames stored in flash, run before the firmware build.
+# Date: 9.December 2024
+#
+# The screens are drawn the way Adafruit GFX draws them with its classic 5x7 font, taken from the installed
+# library, and written as screen_bitmaps.h into the build directory. Without the font nothing is generated
+# and the firmware draws every screen through GFX. At boot the firmware draws each screen through GFX once
+# more and compares, a bitmap that differs turns the pre-rendered screens off.
+
+import os
+import re
+import sys
+
+WIDTH = 128
+HEIGHT = 64
+ROTATION = 2
+
+
+def load_font(path):
+    with open(path) as source:
+        text = source.read()
+    body = text[text.index("{", text.index("font[")) + 1:text.index("};", text.index("font["))]
+    data = [int(value, 16) for value in re.findall(r"0x([0-9A-Fa-f]{2})", body)]
+    if len(data) < 256 * 5:
+        raise ValueError("%s: %d font bytes, expected %d" % (path, len(data), 256 * 5))
+    return data
+
+
+def load_names(path, table):
+    with open(path) as source:
+        text = source.read()
+    match = re.search(table + r"\[\]\s*=\s*\{(.*?)\};", text, re.S)
+    if match is None:
+        raise ValueError("%s: no %s table" % (path, table))
+    return re.findall(r'"([^"]*)"', match.group(1))
+
+
+class Gfx:
+    """The subset of Adafruit_GFX/Adafruit_SSD1306 the screens use, pixel for pixel."""
+
+    def __init__(self, font):
+        self.font = font
+        self.buffer = bytearray(WIDTH * HEIGHT // 8)
+        self.size = 1
+        self.x = 0
+        self.y = 0
+
+    def clear(self):
+        self.buffer = bytearray(WIDTH * HEIGHT // 8)
+
+    def set_text_size(self, size):
+        self.size = max(size, 1)
+
+    def set_cursor(self, x, y):
+        self.x = x
+        self.y = y
+
+    def pixel(self, x, y):
+        if x < 0 or x >= WIDTH or y < 0 or y >= HEIGHT:
+            return
+        if ROTATION == 2:
+            x = WIDTH - x - 1
+            y = HEIGHT - y - 1
+        self.buffer[x + (y // 8) * WIDTH] |= 1 << (y & 7)
+
+    def draw_char(self, code):
+        if code >= 176:  # cp437(false), the default of the library
+            code += 1
+        for column in range(5):
+            line = self.font[code * 5 + column]
+            for row in range(8):
+                if line & (1 << row):
+                    for dx in range(self.size):
+                        for dy in range(self.size):
+                            self.pixel(self.x + column * self.size + dx, self.y + row * self.size + dy)
+
+    def write(self, code):
+        if code == ord("\n"):
+            self.x = 0
+            self.y += self.size * 8
+        elif code != ord("\r"):
+            if self.x + self.size * 6 > WIDTH:  # Text wrap is on by default
+                self.x = 0
+                self.y += self.size * 8
+            self.draw_char(code)
+            self.x += self.size * 6
+
+    def print(self, text):
+        for code in text.encode("latin-1"):
+            self.write(code)
+
+    def println(self, text):
+        self.print(text + "\r\n")
+
+    def text_width(self, text):
+        x, y, min_x, max_x = 0, 0, 0x7FFF, -1
+        for code in text.encode("latin-1"):
+            if code == ord("\n"):
+                x = 0
+                y += self.size * 8
+            elif code != ord("\r"):
+                if x + self.size * 6 > WIDTH:
+                    x = 0
+                    y += self.size * 8
+                max_x = max(max_x, x + self.size * 6 - 1)
+                min_x = min(min_x, x)
+                x += self.size * 6
+        return max_x - min_x + 1 if max_x >= min_x else 0
+
+    def centered(self, text):
+        # getCenteredPosition() in screen.cpp
+        return (WIDTH - self.text_width(text)) // 2
+
+
+# Each mirrors its draw*Screen() in screen.cpp
+
+
+def startup_screen(gfx):
+    gfx.clear()
+    gfx.set_text_size(2)
+    gfx.set_cursor(10, 5)
+    gfx.println("Weather")
+    gfx.set_cursor(25, 25)
+    gfx.println("& Mood")
+    gfx.set_text_size(1)
+    gfx.set_cursor(10, 50)
+    gfx.println("Swipe to pick city")
+
+
+def arrows_screen(gfx, item):
+    gfx.clear()
+    gfx.set_text_size(2)
+    gfx.set_cursor(0, 25)
+    gfx.print("<")
+    gfx.set_cursor(gfx.centered(item), 25)
+    gfx.println(item)
+    gfx.set_cursor(115, 25)
+    gfx.println(">")
+
+
+def timeout_screen(gfx):
+    gfx.clear()
+    gfx.set_text_size(2)
+    gfx.set_cursor(0, 10)
+    gfx.println("CONNECTION")
+    gfx.set_cursor(gfx.centered("TIMEOUT"), 30)
+    gfx.println("TIMEOUT")
+
+
+def frame(gfx, draw, *args):
+    draw(gfx, *args)
+    return bytes(gfx.buffer)
+
+
+def c_array(data):
+    lines = []
+    for offset in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % value for value in data[offset:offset + 16]) + ",")
+    return "\n".join(lines)
+
+
+def generate(font_path, tables_path, output_path):
+    font = load_font(font_path)
+    moods = load_names(tables_path, "MOOD_NAMES")
+    cities = load_names(tables_path, "FEATURED_CITY_NAMES")
+    gfx = Gfx(font)
+    screens = [("STARTUP_SCREEN_BITMAP", [frame(gfx, startup_screen)]),
+               ("TIMEOUT_SCREEN_BITMAP", [frame(gfx, timeout_screen)]),
+               ("MOOD_SCREEN_BITMAPS", [frame(gfx, arrows_screen, mood) for mood in moods]),
+               ("FEATURED_CITY_SCREEN_BITMAPS", [frame(gfx, arrows_screen, city) for city in cities])]
+
+    out = ["// Generated by scripts/prerender_screens.py from the Adafruit GFX classic font, do not edit",
+           "",
+           "#ifndef SCREEN_BITMAPS_H",
+           "#define SCREEN_BITMAPS_H",
+           "",
+           "#include \"render.h\"",
+           "#include \"weather_tables.h\"",
+           ""]
+    for name, frames in screens:
+        if len(frames) == 1:
+            out.append("const uint8_t %s[DISPLAY_BUFFER_SIZE] PROGMEM = {" % name)
+            out.append(c_array(frames[0]))
+        else:
+            count = "MOOD_COUNT" if name.startswith("MOOD") else "FEATURED_CITY_COUNT"
+            out.append("const uint8_t %s[%s][DISPLAY_BUFFER_SIZE] PROGMEM = {" % (name, count))
+            for data in frames:
+                out.append("  {")
+                out.append(c_array(data))
+                out.append("  },")
+        out.append("};")
+        out.append("")
+    out.append("#endif // SCREEN_BITMAPS_H")
+    out.append("")
+
+    os.makedirs(os.path.dirname(output_path), exist_ok=True)
+    with open(output_path, "w") as header:
+        header.write("\n".join(out))
+    return sum(len(frames) for _, frames in screens)
+
+
+def find_font(search_dirs):
+    for directory in search_dirs:
+        if not os.path.isdir(directory):
+            continue
+        for root, _, files in os.walk(directory):
+            if "glcdfont.c" in files and "Adafruit GFX" in root:
+                return os.path.join(root, "glcdfont.c")
+    return None
+
+
+def is_stale(output_path, inputs):
+    if not os.path.exists(output_path):
+        return True
+    built = os.path.getmtime(output_path)
+    return any(os.path.getmtime(path) > built for path in inputs)
+
+
+if __name__ == "__main__":
+    # python3 prerender_screens.py <glcdfont.c> <weather_tables.h> <screen_bitmaps.h>
+    if len(sys.argv) != 4:
+        sys.exit("Usage: %s FONT TABLES OUTPUT" % sys.argv[0])
+    print("%d screens written to %s" % (generate(*sys.argv[1:]), sys.argv[3]))
+else:
+    Import("env")  # noqa: F821, provided by PlatformIO
+
+    project_dir = env.subst("$PROJECT_DIR")
+    tables = os.path.join(project_dir, "..", "common", "include", "weather_tables.h")
+    generated = os.path.join(env.subst("$BUILD_DIR"), "generated")
+    output = os.path.join(generated, "screen_bitmaps.h")
+    font_path = find_font([env.subst("$PROJECT_LIBDEPS_DIR"), os.path.join(project_dir, "lib")])
+    if font_path is None:
+        print("prerender_screens: Adafruit GFX font not found, the screens are drawn at run time")
+    else:
+        inputs = [font_path, tables, os.path.join(project_dir, "scripts", "prerender_screens.py")]
+        if is_stale(output, inputs):
+            print("prerender_screens: %d screens pre-rendered" % generate(font_path, tables, output))
+        env.Append(CPPPATH=[generated], CPPDEFINES=["WEATHER_PRERENDERED_SCREENS"])
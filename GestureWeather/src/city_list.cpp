@@ -0,0 +1,76 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Date: 9.December 2024
+ */
+
+#include "city_list.h"
+
+#include <cstring>
+
+std::string cityListTopic(int page)
+{ // The API replies to the listing request "page" on cities/<page>
+    return std::string(CITY_LIST_TOPIC) + "/" + std::to_string(page);
+}
+
+bool isCityListTopic(const char *topic)
+{
+    size_t length = strlen(CITY_LIST_TOPIC);
+    return strncmp(topic, CITY_LIST_TOPIC, length) == 0 && topic[length] == '/';
+}
+
+// Function to read a non-negative number, stops at the first other character
+static bool readNumber(const char *payload, unsigned int length, unsigned int &i, int &number)
+{
+    unsigned int start = i;
+    number = 0;
+    while (i < length && payload[i] >= '0' && payload[i] <= '9' && number < 100000000)
+    {
+        number = number * 10 + (payload[i] - '0');
+        i++;
+    }
+    return i > start;
+}
+
+bool parseCityPage(const char *payload, unsigned int length, CityPage &cities)
+{
+    unsigned int i = 0;
+    int page, pageSize, total;
+    if (!readNumber(payload, length, i, page) || i >= length || payload[i++] != ' ' ||
+        !readNumber(payload, length, i, pageSize) || i >= length || payload[i++] != ' ' ||
+        !readNumber(payload, length, i, total) || i >= length || payload[i++] != '\n' || pageSize == 0)
+    {
+        return false;
+    }
+    std::vector<std::string> names;
+    while (i < length)
+    {
+        unsigned int start = i;
+        while (i < length && payload[i] != '\n')
+        {
+            i++;
+        }
+        if (i > start)
+        {
+            names.push_back(std::string(payload + start, i - start));
+        }
+        i++;
+    }
+    cities.page = page;
+    cities.pageSize = pageSize;
+    cities.total = total;
+    cities.names.swap(names);
+    cities.isReceived = true;
+    return true;
+}
+
+bool hasCity(const CityPage &cities, int index)
+{
+    int first = cities.page * cities.pageSize;
+    return index >= first && index - first < (int)cities.names.size();
+}
+
+const std::string &cityName(const CityPage &cities, int index)
+{
+    static const std::string unknown = "";
+    return hasCity(cities, index) ? cities.names[index - cities.page * cities.pageSize] : unknown;
+}
@@ -0,0 +1,79 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Date: 9.December 2024
+ */
+
+#include "event_queue.h"
+
+#include <string.h>
+
+bool QueuedLink::command(MqttCommand::Kind kind, const char *topic, const char *payload)
+{
+    MqttCommand queued;
+    if (strlen(topic) >= sizeof(queued.topic) || strlen(payload) >= sizeof(queued.payload))
+    {
+        return false;
+    }
+    queued.kind = kind;
+    strcpy(queued.topic, topic);
+    strcpy(queued.payload, payload);
+    return commands.push(queued);
+}
+
+bool QueuedLink::loop()
+{
+    while (messages.pop(incoming))
+    {
+        handleMessage(station, incoming.topic, incoming.payload, incoming.length);
+    }
+    return true;
+}
+
+bool QueuedLink::hasNewSession()
+{
+    uint32_t current = sessions.load(std::memory_order_acquire);
+    if (current == startedSessions)
+    {
+        return false;
+    }
+    startedSessions = current;
+    return true;
+}
+
+bool QueuedLink::received(const char *topic, const uint8_t *payload, unsigned int length)
+{
+    static MqttMessage message; // Only the network task receives, keep the 600 bytes off its stack
+    if (strlen(topic) >= sizeof(message.topic) || length > sizeof(message.payload))
+    {
+        droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    strcpy(message.topic, topic);
+    memcpy(message.payload, payload, length);
+    message.length = static_cast<uint16_t>(length);
+    if (!messages.push(message))
+    {
+        droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void QueuedLink::runCommands(MqttLink &client)
+{
+    while (commands.pop(outgoing))
+    {
+        switch (outgoing.kind)
+        {
+        case MqttCommand::SUBSCRIBE:
+            client.subscribe(outgoing.topic);
+            break;
+        case MqttCommand::UNSUBSCRIBE:
+            client.unsubscribe(outgoing.topic);
+            break;
+        case MqttCommand::PUBLISH:
+            client.publish(outgoing.topic, outgoing.payload);
+            break;
+        }
+    }
+}
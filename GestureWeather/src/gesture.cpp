@@ -5,34 +5,136 @@
 
 #include "gesture.h"
 
-const std::vector<std::string> emotions = {"Excited", "Happy", "Neutral", "Sad", "Miserable"};
-const std::vector<std::string> city = {"Brno", "Prague", "Ostrava", "Plzen", "Liberec", "Olomouc", "Vienna", "Berlin", "Paris", "London"};
+bool weatherTopicCity(const char *topic, std::string &cityName)
+{
+    std::string name(topic);
+#ifdef WEATHER_BINARY_PAYLOAD
+    size_t suffix = name.rfind("/bin");
+    if (suffix == std::string::npos || suffix + 4 != name.length())
+    {
+        return false;
+    }
+    name.erase(suffix);
+#endif
+    if (name.empty() || name.find('/') != std::string::npos || name == "requests" || name == CITY_LIST_TOPIC)
+    { // Not a city, whatever else reaches the station
+        return false;
+    }
+    cityName = name;
+    return true;
+}
 
-void decreaseMood(std::string &mood)
+std::string weatherTopic(const std::string &cityName)
 {
-    for (int i = 0; i < emotions.size(); ++i)
+    return cityName + WEATHER_TOPIC_SUFFIX;
+}
+
+void requestWeather(MqttLink &client, const std::string &request)
+{ // Send the request to the server in format "city" or "city mood"
+    client.publish("requests", request.c_str());
+    Serial.print("[requests]: ");
+    Serial.println(request.c_str());
+}
+
+bool loadCityPage(const CityPage &cities, PendingPage &pending, int index, MqttLink &client)
+{ // Make sure the page holding the city is in memory, requesting it from the API if it is not
+    if (hasCity(cities, index))
     {
-        if (emotions[i] == mood)
-        {
-            mood = (i == 0) ? emotions[0] : emotions[i - 1];
+        pending.active = false; // A page still on its way would move away from this city
+        return true;
+    }
+    int page = index / cities.pageSize;
+    std::string request = std::to_string(page);
+    pending.active = true;
+    pending.isReceived = false;
+    pending.page = page;
+    pending.city = index;
+    pending.startedAt = millis();
+    client.publish(CITY_LIST_TOPIC, request.c_str());
+    Serial.print("[" CITY_LIST_TOPIC "]: ");
+    Serial.println(request.c_str());
+    return false;
+}
+
+void pollCityPage(PendingPage &pending, const CityPage &cities, int currentState, int &currentCity, Display &display)
+{
+    if (!pending.active)
+    {
+        return;
+    }
+    if (pending.isReceived)
+    {
+        pending.active = false;
+        if (currentState != CITY_STATE)
+        { // The screen shown belongs to the current city, it stays
             return;
         }
+        if (hasCity(cities, pending.city))
+        {
+            currentCity = pending.city;
+        }
+        showCityScreen(display, cityName(cities, currentCity));
+    }
+    else if (millis() - pending.startedAt > PAGE_TIMEOUT_MS)
+    { // The city screen still shows the current city
+        pending.active = false;
+    }
+}
+
+void decreaseMood(Mood &mood)
+{
+    if (mood != Mood::EXCITED)
+    {
+        mood = static_cast<Mood>(static_cast<uint8_t>(mood) - 1);
+    }
+}
+
+void increaseMood(Mood &mood)
+{
+    if (static_cast<uint8_t>(mood) + 1 < MOOD_COUNT)
+    {
+        mood = static_cast<Mood>(static_cast<uint8_t>(mood) + 1);
     }
 }
 
-void increaseMood(std::string &mood)
+void startRequest(PendingRequest &pending, const std::string &city, bool isBackground)
+{
+    pending.active = true;
+    pending.isReceived = false;
+    pending.isBackground = isBackground;
+    pending.city = city;
+    pending.startedAt = millis();
+}
+
+void pollRequest(PendingRequest &pending, const WeatherPayload &weather, Display &display)
 {
-    for (int i = 0; i < emotions.size(); ++i)
+    if (!pending.active)
     {
-        if (emotions[i] == mood)
+        return;
+    }
+    if (pending.isReceived)
+    {
+        pending.active = false;
+        showDetailScreen(weather, display, 0);
+    }
+    else if (millis() - pending.startedAt > REQUEST_TIMEOUT_MS)
+    {
+        pending.active = false;
+        if (!pending.isBackground)
         {
-            mood = (i == emotions.size() - 1) ? emotions[emotions.size() - 1] : emotions[i + 1];
-            return;
+            showTimeoutScreen(display);
         }
     }
 }
 
-void upGesture(std::string &message, int &currentState, int &currentCity, Adafruit_SSD1306 &display, PubSubClient &client, std::string &mood, bool &isReceived)
+// Function to get the age of the cached weather of the city in seconds, 0 if it is not cached
+static unsigned long cachedAge(const WeatherCache &cache, const std::string &cityName)
+{
+    const CachedWeather *cached = findWeather(cache, cityName);
+    return cached != nullptr ? (millis() - cached->receivedAt) / 1000 : 0;
+}
+
+void upGesture(WeatherPayload &weather, const WeatherCache &cache, CityPage &cities, int &currentState, int &currentCity, Display &display, MqttLink &client, Mood &mood, PendingRequest &pending)
 {
     if (currentState == CITY_STATE)
     {
@@ -40,93 +142,70 @@ void upGesture(std::string &message, int &currentState, int &currentCity, Adafru
         showStartupScreen(display);
     }
     else if (currentState == DETAIL_STATE)
-    {
+    { // Also leaves a request still on its way, its reply only updates the weather
+        pending.active = false;
         currentState = CITY_STATE;
-        showCityScreen(display, city[currentCity]);
+        showCityScreen(display, cityName(cities, currentCity));
     }
     else if (currentState == MOOD_STATE)
     {
         currentState = DETAIL_STATE;
-        isReceived = false;
-        std::string request = city[currentCity] + " " + mood;
-        client.subscribe(city[currentCity].c_str());
-        client.publish("requests", request.c_str()); // Send the request to the server in format "city mood"
-        Serial.print("[requests]: ");
-        Serial.println(request.c_str());
-        unsigned long startTime = millis();
-        while (!isReceived)
-        { 
-            display.clearDisplay();
-            display.display();
-            if (millis() - startTime > 3000)
-            {
-            display.setTextSize(2);
-            display.setTextColor(SSD1306_WHITE);
-            display.setCursor(0, 10);
-            display.println("CONNECTION");
-            u_int16_t x = getCenteredPosition(display, "TIMEOUT");
-            display.setCursor(x, 30);
-            display.println("TIMEOUT");
-            display.display();
+        const std::string &name = cityName(cities, currentCity);
+        const CachedWeather *cached = findWeather(cache, name);
+        if (cached != nullptr && cached->weather.mood == static_cast<uint8_t>(mood))
+        { // The cache already holds the snapshot of the city with this mood
+            weather = cached->weather;
+            showDetailScreen(weather, display, cachedAge(cache, name));
             return;
-            }
-            client.loop();
         }
-        showDetailScreen(message, display);
+        startRequest(pending, name, false);
+        requestWeather(client, name + " " + moodName(mood)); // The snapshot is republished with the new mood
+        showLoadingScreen(display);
     }
 }
 
-void downGesture(std::string &message, int &currentState, int &currentCity, Adafruit_SSD1306 &display, PubSubClient &client, std::string &mood, bool &isReceived)
+void downGesture(WeatherPayload &weather, const WeatherCache &cache, CityPage &cities, int &currentState, int &currentCity, Display &display, MqttLink &client, Mood &mood, PendingRequest &pending)
 {
     if (currentState == CITY_STATE)
     {
         currentState = DETAIL_STATE;
-        isReceived = false;
-        client.subscribe(city[currentCity].c_str());
-        client.publish("requests", city[currentCity].c_str()); // Send the request to the server in format "city" only
-        Serial.print("[requests]: ");
-        Serial.println(city[currentCity].c_str());
-        unsigned long startTime = millis();
-        while (!isReceived)
-        { 
-            display.clearDisplay();
-            display.display();
-            if (millis() - startTime > 3000)
-            {
-            display.setTextSize(2);
-            display.setTextColor(SSD1306_WHITE);
-            display.setCursor(0, 10);
-            display.println("CONNECTION");
-            u_int16_t x = getCenteredPosition(display, "TIMEOUT");
-            display.setCursor(x, 30);
-            display.println("TIMEOUT");
-            display.display();
+        const std::string &name = cityName(cities, currentCity);
+        const CachedWeather *cached = findWeather(cache, name);
+        if (cached == nullptr)
+        {
+            startRequest(pending, name, false);
+            requestWeather(client, name);
+            showLoadingScreen(display);
             return;
-            }
-            client.loop();
         }
-        showDetailScreen(message, display);
+        // Every update of the city reaches the cache through the subscription, ask only for an old reading
+        weather = cached->weather;
+        unsigned long age = cachedAge(cache, name);
+        showDetailScreen(weather, display, age);
+        if (age >= WEATHER_REFRESH_AFTER_S)
+        {
+            startRequest(pending, name, true);
+            requestWeather(client, name);
+        }
     }
-    else if (currentState == DETAIL_STATE)
-    {
+    else if (currentState == DETAIL_STATE && (!pending.active || pending.isBackground))
+    { // The mood screen starts from the weather shown, wait for it first. A refresh still updates the weather.
+        pending.active = false;
         currentState = MOOD_STATE;
         showMoodScreen(mood, display);
     }
 }
 
-void leftGesture(int &currentState, int &currentCity, Adafruit_SSD1306 &display, std::string &mood)
+void leftGesture(CityPage &cities, int &currentState, int &currentCity, Display &display, MqttLink &client, Mood &mood, PendingPage &pendingPage)
 {
     if (currentState == CITY_STATE)
-    {
-        if (currentCity == 0)
-        {
-            currentCity = 9;
-        }
-        else
+    { // Across a page boundary the city changes once pollCityPage() sees its page
+        int previousCity = (currentCity == 0) ? cities.total - 1 : currentCity - 1;
+        if (loadCityPage(cities, pendingPage, previousCity, client))
         {
-            currentCity--;
+            currentCity = previousCity;
+            showCityScreen(display, cityName(cities, currentCity));
         }
-        showCityScreen(display, city[currentCity]);
     }
     else if (currentState == MOOD_STATE)
     {
@@ -135,19 +214,16 @@ void leftGesture(int &currentState, int &currentCity, Adafruit_SSD1306 &display,
     }
 }
 
-void rightGesture(int &currentState, int &currentCity, Adafruit_SSD1306 &display, std::string &mood)
+void rightGesture(CityPage &cities, int &currentState, int &currentCity, Display &display, MqttLink &client, Mood &mood, PendingPage &pendingPage)
 {
     if (currentState == CITY_STATE)
     {
-        if (currentCity == 9)
-        {
-            currentCity = 0;
-        }
-        else
+        int nextCity = (currentCity >= cities.total - 1) ? 0 : currentCity + 1;
+        if (loadCityPage(cities, pendingPage, nextCity, client))
         {
-            currentCity++;
+            currentCity = nextCity;
+            showCityScreen(display, cityName(cities, currentCity));
         }
-        showCityScreen(display, city[currentCity]);
     }
     else if (currentState == MOOD_STATE)
     {
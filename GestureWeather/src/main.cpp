@@ -3,10 +3,10 @@
  * Date: 9.December 2024
  */
 
-#include <SparkFun_APDS9960.h>
 #include <WiFi.h>
 
-#include "gesture.h"
+#include "event_queue.h"
+#include "platform_esp32.h"
 
 // Sensor pins
 #define APDS9960_INT 26
@@ -23,39 +23,42 @@
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT,
-                         SPI_MOSI, SPI_CLK, SPI_DC, SPI_RESET, SPI_CS);
+PartialSsd1306 display(SCREEN_WIDTH, SCREEN_HEIGHT,
+                       SPI_MOSI, SPI_CLK, SPI_DC, SPI_RESET, SPI_CS);
 SparkFun_APDS9960 apds = SparkFun_APDS9960();
-volatile int isr_flag = 0;
+volatile uint32_t interruptAt = 0; // micros() of the last gesture interrupt
 
 // WiFi and MQTT
 const char *WIFI_SSID = ""; // Set WiFi name
 const char *WIFI_PASS = ""; // Set WiFi password 
 const char *MQTT_BROKER = ""; // Set MQTT broker
 
-// States
-int currentState = START_STATE;
-int currentCity = 0;
-bool isReceived = false;
-
 WiFiClient espClient;
 PubSubClient client(espClient);
-std::string message;
-std::string mood = "Neutral";
+Ssd1306Display screen(display);
+PubSubLink mqttLink(client);
+Apds9960Sensor sensor(apds);
+Station station = newStation();
+
+// Tasks: the gesture task reads the sensor on core 0, away from the network and the display. The UI task owns
+// the station and the display, loop() stays the network task and owns the MQTT client. Both run on core 1.
+TaskHandle_t gestureTask = nullptr;
+TaskHandle_t uiTask = nullptr;
+QueuedGestures gestures;
+QueuedLink queuedLink(station);
 
 void callback(char *topic, byte *payload, unsigned int length)
-{
-  Serial.print("[");
-  Serial.print(topic);
-  Serial.print("]: ");
-  message = "";
-  for (int i = 0; i < length; i++)
+{ // Runs in the network task, the UI task parses the message
+  if (queuedLink.received(topic, payload, length))
   {
-    message += (char)payload[i];
+    xTaskNotifyGive(uiTask);
+  }
+  else
+  {
+    Serial.print("[");
+    Serial.print(topic);
+    Serial.println("]: dropped");
   }
-  isReceived = true;
-  Serial.print(message.c_str());
-  Serial.println();
 }
 
 void reconnect()
@@ -66,6 +69,11 @@ void reconnect()
     if (client.connect("user"))
     {
       Serial.println("connected");
+      // Pages the UI task asks for arrive here. Learn the number of cities, the reply replaces the built-in page.
+      client.subscribe(CITY_LIST_FILTER);
+      client.publish(CITY_LIST_TOPIC, "0");
+      queuedLink.connected(); // The session is clean, the UI task subscribes its page again
+      xTaskNotifyGive(uiTask);
     }
     else
     {
@@ -79,42 +87,68 @@ void reconnect()
 
 void IRAM_ATTR interruptRoutine()
 {
-  isr_flag = 1;
+  interruptAt = micros();
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(gestureTask, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void gestureLoop(void *)
+{ // The read blocks over I2C until the swipe is over, the UI goes on meanwhile
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    detachInterrupt(digitalPinToInterrupt(APDS9960_INT));
+    if (sensor.isGestureAvailable())
+    {
+      GestureEvent event = {sensor.readSwipe(), interruptAt, static_cast<uint32_t>(micros())};
+      if (gestures.push(event))
+      {
+        xTaskNotifyGive(uiTask);
+      }
+      else
+      {
+        Serial.println("gesture dropped");
+      }
+    }
+    attachInterrupt(digitalPinToInterrupt(APDS9960_INT), interruptRoutine, FALLING);
+  }
 }
 
-void handleGesture()
+// Function to log where the time from the interrupt to the flushed frame went
+void reportLatency(const GestureEvent &event, uint32_t dequeuedAt, uint32_t renderedAt)
 {
-  if (apds.isGestureAvailable())
+  Serial.print("latency: ");
+  Serial.print((unsigned long)(renderedAt - event.interruptAt));
+  Serial.print(" us, read ");
+  Serial.print((unsigned long)(event.readAt - event.interruptAt));
+  Serial.print(", queued ");
+  Serial.print((unsigned long)(dequeuedAt - event.readAt));
+  Serial.print(", handled ");
+  Serial.print((unsigned long)(renderedAt - dequeuedAt));
+  Serial.print(" (frame ");
+  Serial.print((unsigned long)screen.lastFlushBytes);
+  Serial.print(" bytes in ");
+  Serial.print(screen.lastFlushMicros);
+  Serial.println(" us)");
+}
+
+void uiLoop(void *)
+{
+  for (;;)
   {
-    int gesture = apds.readGesture();
-    if (currentState == START_STATE && (gesture == DIR_UP || gesture == DIR_DOWN || gesture == DIR_LEFT || gesture == DIR_RIGHT))
-    { // Move from the start screen to the default city screen
-      currentState = CITY_STATE;
-      currentCity = 0;
-      showCityScreen(display, "Brno");
-      return;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20)); // Woken by a gesture or a message, else in time for the request deadlines
+    if (queuedLink.hasNewSession())
+    { // After every connect, the first one included
+      startStation(station, queuedLink);
     }
-    switch (gesture)
+    queuedLink.loop();
+    pollStation(station, screen, queuedLink);
+    if (gestures.isGestureAvailable())
     {
-    case DIR_UP:
-      upGesture(message, currentState, currentCity, display, client, mood, isReceived);
-      Serial.println("UP");
-      break;
-    case DIR_DOWN:
-      downGesture(message, currentState, currentCity, display, client, mood, isReceived);
-      Serial.println("DOWN");
-      break;
-    case DIR_LEFT:
-      leftGesture(currentState, currentCity, display, mood);
-      Serial.println("LEFT");
-      break;
-    case DIR_RIGHT:
-      rightGesture(currentState, currentCity, display, mood);
-      Serial.println("RIGHT");
-      break;
-    default: // If the gesture is not a swipe, ignore it
-      Serial.println("UNKNOWN");
-      break;
+      uint32_t dequeuedAt = micros();
+      handleGesture(station, gestures, screen, queuedLink);
+      reportLatency(gestures.lastEvent(), dequeuedAt, micros());
     }
   }
 }
@@ -149,8 +183,6 @@ void setup()
       ; // Halt execution
   }
 
-  attachInterrupt(digitalPinToInterrupt(APDS9960_INT), interruptRoutine, FALLING);
-
   // Initialize SPI display
   if (!display.begin(SSD1306_SWITCHCAPVCC))
   {
@@ -169,24 +201,30 @@ void setup()
   Serial.println("connected");
 
   client.setServer(MQTT_BROKER, 1883);
+  client.setBufferSize(512); // A page of the city listing does not fit the default 256 bytes
   client.setCallback(callback);
 
-  showStartupScreen(display);
+  int differences = checkPrerenderedScreens(screen);
+  if (differences > 0)
+  { // The font or a screen layout changed without the bitmaps, draw everything through GFX
+    Serial.print(differences);
+    Serial.println(" pre-rendered screens differ from GFX, not using them");
+  }
+  showStartupScreen(screen);
+
+  // The same priority as loop(), so the two share core 1
+  xTaskCreatePinnedToCore(uiLoop, "ui", 8192, nullptr, 1, &uiTask, 1);
+  xTaskCreatePinnedToCore(gestureLoop, "gesture", 4096, nullptr, 2, &gestureTask, 0);
+  attachInterrupt(digitalPinToInterrupt(APDS9960_INT), interruptRoutine, FALLING);
 }
 
 void loop()
-{
+{ // The network task, it carries out the subscribes and publishes of the UI task
   if (!client.connected())
   {
     reconnect();
   }
   client.loop();
-
-  if (isr_flag == 1)
-  { // If the gesture is detected, handle it
-    detachInterrupt(digitalPinToInterrupt(APDS9960_INT));
-    handleGesture();
-    isr_flag = 0;
-    attachInterrupt(digitalPinToInterrupt(APDS9960_INT), interruptRoutine, FALLING);
-  }
-}
\ No newline at end of file
+  queuedLink.runCommands(mqttLink);
+  delay(1); // Leave core 1 to the UI task between the polls
+}
@@ -0,0 +1,82 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Date: 9.December 2024
+ */
+
+#include "render.h"
+
+#include <string.h>
+
+size_t FrameDiff::diff(const uint8_t *frame, DirtySpan spans[DISPLAY_PAGES])
+{
+    size_t bytes = 0;
+    for (int page = 0; page < DISPLAY_PAGES; ++page)
+    {
+        const uint8_t *now = frame + page * DISPLAY_WIDTH;
+        const uint8_t *before = flushed + page * DISPLAY_WIDTH;
+        DirtySpan &span = spans[page];
+        span.dirty = false;
+        int first = 0;
+        int last = DISPLAY_WIDTH - 1;
+        if (valid)
+        { // Trim the unchanged columns on both ends
+            while (first < DISPLAY_WIDTH && now[first] == before[first])
+            {
+                first++;
+            }
+            if (first == DISPLAY_WIDTH)
+            {
+                continue;
+            }
+            while (now[last] == before[last])
+            {
+                last--;
+            }
+        }
+        span.dirty = true;
+        span.first = static_cast<uint8_t>(first);
+        span.last = static_cast<uint8_t>(last);
+        bytes += FLUSH_COMMAND_BYTES + last - first + 1;
+    }
+    memcpy(flushed, frame, DISPLAY_BUFFER_SIZE);
+    valid = true;
+    return bytes;
+}
+
+TextMetricsCache::Key TextMetricsCache::keyOf(const char *text, uint8_t size, int16_t x, int16_t y)
+{ // FNV-1a and djb2 over the text and the drawing parameters, the first one never 0
+    uint32_t h = 2166136261u;
+    uint32_t check = 5381;
+    uint16_t length = 0;
+    for (; *text != '\0'; ++text, ++length)
+    {
+        h = (h ^ static_cast<uint8_t>(*text)) * 16777619u;
+        check = check * 33 + static_cast<uint8_t>(*text);
+    }
+    h = (h ^ size) * 16777619u;
+    h = (h ^ static_cast<uint16_t>(x)) * 16777619u;
+    h = (h ^ static_cast<uint16_t>(y)) * 16777619u;
+    check = ((check * 33 + size) * 33 + static_cast<uint16_t>(x)) * 33 + static_cast<uint16_t>(y);
+    return Key{h != 0 ? h : 1, check, length};
+}
+
+bool TextMetricsCache::find(const char *text, uint8_t size, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h)
+{
+    Key key = keyOf(text, size, x, y);
+    const Entry &entry = entries[key.hash % SLOTS];
+    if (entry.key.hash != key.hash || entry.key.check != key.check || entry.key.length != key.length)
+    {
+        return false;
+    }
+    *x1 = entry.x1;
+    *y1 = entry.y1;
+    *w = entry.w;
+    *h = entry.h;
+    return true;
+}
+
+void TextMetricsCache::store(const char *text, uint8_t size, int16_t x, int16_t y, int16_t x1, int16_t y1, uint16_t w, uint16_t h)
+{
+    Key key = keyOf(text, size, x, y);
+    entries[key.hash % SLOTS] = Entry{key, x1, y1, w, h};
+}
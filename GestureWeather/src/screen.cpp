@@ -5,80 +5,131 @@
 
 #include "screen.h"
 
-void parseMessage(std::string &message, std::string &temperature, std::string &humidity, std::string &mood)
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef WEATHER_PRERENDERED_SCREENS
+// Generated into the build directory by scripts/prerender_screens.py
+#include "screen_bitmaps.h"
+
+static bool isPrerendered = true; // Cleared when a bitmap differs from what GFX draws
+#define PRERENDERED(bitmap) (isPrerendered ? (bitmap) : nullptr)
+#else
+#define PRERENDERED(bitmap) nullptr
+#endif
+
+// Function to read the value after the next ':' up to the stop character, returns the position after it or npos
+static size_t readField(const std::string &message, size_t from, char stop, std::string &value)
 {
-    std::string temp = "";
-    std::string hum = "";
-    std::string md = "";
-    int i = 0;
-    while (message[i] != ':')
-    {
-        i++;
-    }
-    i += 2;
-    while (message[i] != ',')
+    size_t colon = message.find(':', from);
+    if (colon == std::string::npos)
     {
-        temp += message[i];
-        i++;
+        return std::string::npos;
     }
-    i += 2;
-    while (message[i] != ':')
+    size_t begin = message.find_first_not_of(" \"", colon + 1);
+    if (begin == std::string::npos)
     {
-        i++;
+        return std::string::npos;
     }
-    i += 2;
-    while (message[i] != ',')
+    size_t end = message.find(stop, begin);
+    if (end == std::string::npos)
     {
-        hum += message[i];
-        i++;
+        return std::string::npos;
     }
-    i += 2;
-    while (message[i] != ':')
-    {
-        i++;
-    }
-    i += 3;
-    while (message[i] != '"')
+    value = message.substr(begin, end - begin);
+    return end + 1;
+}
+
+bool parseMessage(const std::string &message, std::string &temperature, std::string &humidity, std::string &mood)
+{ // Every search is bounded by the message, a truncated or garbled one is rejected
+    std::string temp;
+    std::string hum;
+    std::string md;
+    size_t i = readField(message, 0, ',', temp);
+    i = i != std::string::npos ? readField(message, i, ',', hum) : i;
+    i = i != std::string::npos ? readField(message, i, '"', md) : i;
+    if (i == std::string::npos)
     {
-        md += message[i];
-        i++;
+        return false;
     }
     temperature = temp;
     humidity = hum;
     mood = md;
+    return true;
+}
+
+// Function to read a whole number, returns false if the text holds anything else
+static bool readInteger(const std::string &text, long &number)
+{
+    char *end = nullptr;
+    number = strtol(text.c_str(), &end, 10);
+    return !text.empty() && end != text.c_str() && *end == '\0';
+}
+
+bool parseWeatherMessage(const std::string &message, WeatherPayload &weather)
+{ // Convert the JSON payload to the same form as the binary one
+    std::string temperature;
+    std::string humidity;
+    std::string mood;
+    long temperatureValue, humidityValue;
+    if (!parseMessage(message, temperature, humidity, mood) || !readInteger(temperature, temperatureValue) ||
+        !readInteger(humidity, humidityValue) || temperatureValue < -3276 || temperatureValue > 3276 ||
+        humidityValue < 0 || humidityValue > 100)
+    {
+        return false;
+    }
+    weather.temperatureTenths = static_cast<int16_t>(temperatureValue * 10);
+    weather.humidity = static_cast<uint8_t>(humidityValue);
+    Mood parsed = Mood::NEUTRAL;
+    findMood(mood.c_str(), mood.length(), parsed);
+    weather.mood = static_cast<uint8_t>(parsed);
+    weather.timestamp = 0;
+    return true;
 }
 
-int16_t getCenteredPosition(Adafruit_SSD1306 &display, std::string item)
+int16_t getCenteredPosition(Display &display, const char *item)
 { // Calculate the position to center the text on the screen
     int16_t x1, y1;
     uint16_t w, h;
-    display.getTextBounds(item.c_str(), 0, 0, &x1, &y1, &w, &h);
-    return (128 - w) / 2;
+    display.getTextBounds(item, 0, 0, &x1, &y1, &w, &h);
+    return (DISPLAY_WIDTH - w) / 2;
 }
 
-void showStartupScreen(Adafruit_SSD1306 &display)
+// Function to show a pre-rendered screen, returns false if there is none and it has to be drawn
+static bool showFrame(Display &display, const uint8_t *frame)
+{
+    if (frame == nullptr)
+    {
+        return false;
+    }
+    display.setRotation(2); // For the screens drawn after it
+    display.drawFrame(frame);
+    display.display();
+    return true;
+}
+
+static void drawStartupScreen(Display &display)
 {
     display.clearDisplay();
     display.setRotation(2);
 
     // Title
     display.setTextSize(2);
-    display.setTextColor(SSD1306_WHITE);
+    display.setTextColor(DISPLAY_WHITE);
     display.setCursor(10, 5);
-    display.println(F("Weather"));
+    display.println("Weather");
 
     display.setCursor(25, 25);
-    display.println(F("& Mood"));
+    display.println("& Mood");
 
     // Subtitle
     display.setTextSize(1);
     display.setCursor(10, 50);
-    display.println(F("10 European cities"));
-
-    display.display();
+    display.println("Swipe to pick city");
 }
 
-void showCityScreen(Adafruit_SSD1306 &display, std::string city)
+// Function to draw a city or a mood between the arrows
+static void drawArrowsScreen(Display &display, const char *item)
 {
     display.clearDisplay();
     display.setRotation(2);
@@ -86,37 +137,87 @@ void showCityScreen(Adafruit_SSD1306 &display, std::string city)
     display.setTextSize(2);
     display.setCursor(0, 25);
     display.print("<");
-    int16_t x = getCenteredPosition(display, city);
+    int16_t x = getCenteredPosition(display, item);
     display.setCursor(x, 25);
-    display.println(city.c_str());
+    display.println(item);
     display.setCursor(115, 25);
     display.println(">");
+}
 
-    display.display();
+static void drawTimeoutScreen(Display &display)
+{
+    display.clearDisplay();
+    display.setRotation(2);
+
+    display.setTextSize(2);
+    display.setTextColor(DISPLAY_WHITE);
+    display.setCursor(0, 10);
+    display.println("CONNECTION");
+    int16_t x = getCenteredPosition(display, "TIMEOUT");
+    display.setCursor(x, 30);
+    display.println("TIMEOUT");
 }
 
-void showDetailScreen(std::string &message, Adafruit_SSD1306 &display)
+int checkPrerenderedScreens(Display &display)
 {
-    std::string temperature;
-    std::string humidity;
-    std::string mood;
-    parseMessage(message, temperature, humidity, mood);
-    if (std::stoi(temperature) > 999)
+    int differences = 0;
+#ifdef WEATHER_PRERENDERED_SCREENS
+    drawStartupScreen(display);
+    differences += display.frameEquals(STARTUP_SCREEN_BITMAP) ? 0 : 1;
+    drawTimeoutScreen(display);
+    differences += display.frameEquals(TIMEOUT_SCREEN_BITMAP) ? 0 : 1;
+    for (uint8_t mood = 0; mood < MOOD_COUNT; ++mood)
     {
-        temperature = "999";
+        drawArrowsScreen(display, MOOD_NAMES[mood]);
+        differences += display.frameEquals(MOOD_SCREEN_BITMAPS[mood]) ? 0 : 1;
     }
-    if (std::stoi(temperature) < -99)
+    for (size_t city = 0; city < FEATURED_CITY_COUNT; ++city)
     {
-        temperature = "-99";
+        drawArrowsScreen(display, FEATURED_CITY_NAMES[city]);
+        differences += display.frameEquals(FEATURED_CITY_SCREEN_BITMAPS[city]) ? 0 : 1;
     }
-    if (std::stoi(humidity) > 99)
+    isPrerendered = differences == 0;
+#endif
+    display.clearDisplay();
+    return differences;
+}
+
+void showStartupScreen(Display &display)
+{
+    if (!showFrame(display, PRERENDERED(STARTUP_SCREEN_BITMAP)))
     {
-        humidity = "99";
+        drawStartupScreen(display);
+        display.display();
     }
-    if (std::stoi(humidity) < 0)
+}
+
+void showCityScreen(Display &display, std::string city)
+{
+    int featured = findFeaturedCity(city.c_str(), city.length());
+    if (!showFrame(display, featured >= 0 ? PRERENDERED(FEATURED_CITY_SCREEN_BITMAPS[featured]) : nullptr))
     {
-        humidity = "0";
+        drawArrowsScreen(display, city.c_str());
+        display.display();
     }
+}
+
+void showDetailScreen(const WeatherPayload &weather, Display &display, unsigned long ageSeconds)
+{
+    int temperature = (weather.temperatureTenths + (weather.temperatureTenths < 0 ? -5 : 5)) / 10; // Round to whole degrees
+    int humidity = weather.humidity;
+    if (temperature > 999)
+    {
+        temperature = 999;
+    }
+    if (temperature < -99)
+    {
+        temperature = -99;
+    }
+    if (humidity > 99)
+    {
+        humidity = 99;
+    }
+    const char *mood = moodName(static_cast<Mood>(weather.mood));
 
     display.clearDisplay();
     display.setRotation(2);
@@ -124,7 +225,7 @@ void showDetailScreen(std::string &message, Adafruit_SSD1306 &display)
     // Temperature
     display.setTextSize(3);
     display.setCursor(0, 10);
-    display.print(temperature.c_str());
+    display.print(temperature);
     display.setTextSize(2);
     display.print((char)247); // Degree symbol
     display.println("C");
@@ -132,31 +233,51 @@ void showDetailScreen(std::string &message, Adafruit_SSD1306 &display)
     // Humidity
     display.setCursor(80, 10);
     display.setTextSize(3);
-    display.print(humidity.c_str());
+    display.print(humidity);
     display.setTextSize(2);
     display.println("%");
 
     int16_t x = getCenteredPosition(display, mood);
     display.setCursor(x, 45);
-    display.println(mood.c_str());
+    display.println(mood);
+
+    if (ageSeconds > 0)
+    { // Age of the cached reading in the top right corner, like "40s", "5m" or "2h"
+        char age[8];
+        unsigned long value = ageSeconds < 60 ? ageSeconds : (ageSeconds < 3600 ? ageSeconds / 60 : ageSeconds / 3600);
+        char unit = ageSeconds < 60 ? 's' : (ageSeconds < 3600 ? 'm' : 'h');
+        snprintf(age, sizeof(age), "%lu%c", value > 999 ? 999 : value, unit);
+        display.setTextSize(1);
+        int16_t x1, y1;
+        uint16_t w, h;
+        display.getTextBounds(age, 0, 0, &x1, &y1, &w, &h);
+        display.setCursor(DISPLAY_WIDTH - w, 0);
+        display.print(age);
+    }
 
     display.display();
 }
 
-void showMoodScreen(std::string &mood, Adafruit_SSD1306 &display)
+void showMoodScreen(Mood mood, Display &display)
 {
-    display.clearDisplay();
-    display.setRotation(2);
-
-    // Title
-    display.setTextSize(2);
-    display.setCursor(0, 25);
-    display.print("<");
-    int16_t x = getCenteredPosition(display, mood);
-    display.setCursor(x, 25);
-    display.println(mood.c_str());
-    display.setCursor(115, 25);
-    display.println(">");
+    if (!showFrame(display, PRERENDERED(MOOD_SCREEN_BITMAPS[static_cast<uint8_t>(mood)])))
+    {
+        drawArrowsScreen(display, moodName(mood));
+        display.display();
+    }
+}
 
+void showLoadingScreen(Display &display)
+{
+    display.clearDisplay();
     display.display();
 }
+
+void showTimeoutScreen(Display &display)
+{
+    if (!showFrame(display, PRERENDERED(TIMEOUT_SCREEN_BITMAP)))
+    {
+        drawTimeoutScreen(display);
+        display.display();
+    }
+}
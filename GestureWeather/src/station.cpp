@@ -0,0 +1,261 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Date: 9.December 2024
+ */
+
+#include "station.h"
+
+#include <algorithm>
+#include <utility>
+
+Station newStation()
+{
+    Station station;
+    station.currentState = START_STATE;
+    station.currentCity = 0;
+    station.pending = PendingRequest();
+    station.pendingPage = PendingPage();
+    station.weather = WeatherPayload();
+    clearWeatherCache(station.cache);
+    station.cities = {0, FEATURED_CITY_COUNT, FEATURED_CITY_COUNT,
+                      std::vector<std::string>(FEATURED_CITY_NAMES, FEATURED_CITY_NAMES + FEATURED_CITY_COUNT), false};
+    station.mood = Mood::NEUTRAL;
+    station.prefetchNext = -1;
+    station.prefetchAt = 0;
+    station.isStarted = false;
+    station.followedPage = -1;
+    return station;
+}
+
+// Function to tell whether the city is on the page of the listing in memory
+static bool isOnPage(const CityPage &cities, const std::string &name)
+{
+    for (const std::string &city : cities.names)
+    {
+        if (city == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to subscribe to the weather of the city unless it is already, returns false while the outgoing queue is full
+static bool followCity(Station &station, MqttLink &client, const std::string &name)
+{
+    std::vector<std::string> &followed = station.followed;
+    if (std::find(followed.begin(), followed.end(), name) != followed.end())
+    {
+        return true;
+    }
+    if (!client.subscribe(weatherTopic(name).c_str()))
+    {
+        return false;
+    }
+    followed.push_back(name);
+    return true;
+}
+
+// Function to move the weather subscriptions to the cities of the page in memory, a few per call. The retained
+// snapshot of every city comes with its subscription, a subscription to all cities would flood the message queue.
+// Once the page is followed, its prefetch waits a moment for those snapshots.
+static void followPage(Station &station, MqttLink &client)
+{
+    std::vector<std::string> &followed = station.followed;
+    int commands = 0;
+    for (size_t i = 0; i < followed.size() && commands < FOLLOW_PER_POLL;)
+    {
+        if (isOnPage(station.cities, followed[i]))
+        {
+            i++;
+            continue;
+        }
+        if (!client.unsubscribe(weatherTopic(followed[i]).c_str()))
+        {
+            return; // Retried on the next poll while the outgoing queue is full
+        }
+        followed.erase(followed.begin() + i);
+        commands++;
+    }
+    for (const std::string &name : station.cities.names)
+    {
+        if (commands >= FOLLOW_PER_POLL)
+        {
+            return;
+        }
+        if (std::find(followed.begin(), followed.end(), name) != followed.end())
+        {
+            continue;
+        }
+        if (!followCity(station, client, name))
+        {
+            return;
+        }
+        commands++;
+    }
+    station.followedPage = station.cities.page;
+    station.prefetchAt = millis() + PREFETCH_DELAY_MS;
+}
+
+void startStation(Station &station, MqttLink &client)
+{ // Nothing is subscribed in a new session
+    station.isStarted = true;
+    station.followed.clear();
+    station.followedPage = -1;
+    station.prefetchNext = 0;
+    followPage(station, client);
+}
+
+void handleMessage(Station &station, const char *topic, const uint8_t *payload, unsigned int length)
+{
+    Serial.print("[");
+    Serial.print(topic);
+    Serial.print("]: ");
+    if (isCityListTopic(topic))
+    {
+        CityPage page;
+        if (!parseCityPage((const char *)payload, length, page))
+        {
+            Serial.println("invalid city page");
+            return;
+        }
+        bool isAwaited = station.pendingPage.active && page.page == station.pendingPage.page;
+        if (!isAwaited && page.page != station.cities.page)
+        { // Asked for by another display
+            Serial.println("ignored");
+            return;
+        }
+        if (page.page != station.cities.page)
+        { // The new page is prefetched once it is followed
+            station.prefetchNext = 0;
+        }
+        station.cities = std::move(page);
+        station.followedPage = -1;
+        if (isAwaited)
+        {
+            station.pendingPage.isReceived = true;
+        }
+        Serial.print("page ");
+        Serial.print(station.cities.page);
+        Serial.print(" of ");
+        Serial.print(station.cities.total);
+        Serial.println(" cities");
+        return;
+    }
+    std::string name;
+    if (!weatherTopicCity(topic, name))
+    {
+        Serial.println("ignored");
+        return;
+    }
+    WeatherPayload weather;
+#ifdef WEATHER_BINARY_PAYLOAD
+    if (!decodeWeatherPayload(payload, length, weather))
+    {
+        Serial.println("invalid payload");
+        return;
+    }
+    Serial.print(weather.temperatureTenths);
+    Serial.print(" ");
+    Serial.print(weather.humidity);
+    Serial.print(" ");
+    Serial.print(moodName(static_cast<Mood>(weather.mood)));
+#else
+    std::string message((const char *)payload, length);
+    if (!parseWeatherMessage(message, weather))
+    {
+        Serial.println("invalid payload");
+        return;
+    }
+    Serial.print(message.c_str());
+#endif
+    bool isAwaited = station.pending.active && station.pending.city == name;
+    // The cities nobody looks at only fill free slots
+    storeWeather(station.cache, name, weather, millis(), isAwaited || isOnPage(station.cities, name));
+    if (isAwaited)
+    {
+        station.weather = weather;
+        station.pending.isReceived = true;
+    }
+    Serial.println();
+}
+
+void handleGesture(Station &station, GestureSensor &sensor, Display &display, MqttLink &client)
+{
+    if (!sensor.isGestureAvailable())
+    {
+        return;
+    }
+    Swipe swipe = sensor.readSwipe();
+    if (station.currentState == START_STATE && swipe != SWIPE_NONE)
+    { // Move from the start screen to the default city screen
+        station.currentState = CITY_STATE;
+        if (loadCityPage(station.cities, station.pendingPage, 0, client))
+        {
+            station.currentCity = 0;
+        }
+        showCityScreen(display, cityName(station.cities, station.currentCity));
+        return;
+    }
+    switch (swipe)
+    {
+    case SWIPE_UP:
+        upGesture(station.weather, station.cache, station.cities, station.currentState, station.currentCity, display, client, station.mood, station.pending);
+        Serial.println("UP");
+        break;
+    case SWIPE_DOWN:
+        downGesture(station.weather, station.cache, station.cities, station.currentState, station.currentCity, display, client, station.mood, station.pending);
+        Serial.println("DOWN");
+        break;
+    case SWIPE_LEFT:
+        leftGesture(station.cities, station.currentState, station.currentCity, display, client, station.mood, station.pendingPage);
+        Serial.println("LEFT");
+        break;
+    case SWIPE_RIGHT:
+        rightGesture(station.cities, station.currentState, station.currentCity, display, client, station.mood, station.pendingPage);
+        Serial.println("RIGHT");
+        break;
+    default: // If the gesture is not a swipe, ignore it
+        Serial.println("UNKNOWN");
+        break;
+    }
+    if (station.pending.active && !station.pending.isReceived)
+    { // The reply must not wait for followPage() to reach the city, else only the timeout comes
+        followCity(station, client, station.pending.city);
+    }
+}
+
+void pollStation(Station &station, Display &display, MqttLink &client)
+{
+    pollRequest(station.pending, station.weather, display);
+    pollCityPage(station.pendingPage, station.cities, station.currentState, station.currentCity, display);
+    if (station.isStarted && station.followedPage != station.cities.page)
+    {
+        followPage(station, client);
+    }
+    if (station.prefetchNext < 0 || station.followedPage != station.cities.page ||
+        static_cast<long>(millis() - station.prefetchAt) < 0)
+    {
+        return;
+    }
+    // The retained snapshots came with the subscriptions, ask the API for the rest of the page one by one. Every
+    // city asked for is subscribed, so the replies reach the cache.
+    const std::vector<std::string> &names = station.cities.names;
+    while (station.prefetchNext < static_cast<int>(names.size()) &&
+           findWeather(station.cache, names[station.prefetchNext]) != nullptr)
+    {
+        station.prefetchNext++;
+    }
+    if (station.prefetchNext >= static_cast<int>(names.size()))
+    {
+        station.prefetchNext = -1;
+        return;
+    }
+    const std::string &name = names[station.prefetchNext];
+    if (client.publish("requests", name.c_str())) // Retried on the next poll while the outgoing queue is full
+    {
+        Serial.print("[requests]: ");
+        Serial.println(name.c_str());
+        station.prefetchNext++;
+    }
+}
@@ -0,0 +1,66 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Date: 9.December 2024
+ */
+
+#include "weather_cache.h"
+
+// Function to tell whether the slot holds the city, both hashes of the name must match
+static bool isCity(const CachedWeather &slot, uint32_t city, uint32_t check)
+{
+    return slot.city == city && slot.check == check;
+}
+
+void clearWeatherCache(WeatherCache &cache)
+{
+    for (CachedWeather &slot : cache.slots)
+    {
+        slot.city = 0;
+        slot.check = 0;
+        slot.receivedAt = 0;
+        slot.weather = WeatherPayload();
+    }
+}
+
+const CachedWeather *findWeather(const WeatherCache &cache, const std::string &cityName)
+{
+    uint32_t city = cityKey(cityName);
+    uint32_t check = cityCheck(cityName);
+    for (const CachedWeather &slot : cache.slots)
+    {
+        if (isCity(slot, city, check))
+        {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void storeWeather(WeatherCache &cache, const std::string &cityName, const WeatherPayload &weather, unsigned long now, bool evict)
+{ // Update the city in place, else take a free slot, else the one received longest ago
+    uint32_t city = cityKey(cityName);
+    uint32_t check = cityCheck(cityName);
+    CachedWeather *target = &cache.slots[0];
+    bool isCached = false;
+    for (CachedWeather &slot : cache.slots)
+    {
+        if (isCity(slot, city, check))
+        {
+            target = &slot;
+            isCached = true;
+            break;
+        }
+        if (target->city != 0 && (slot.city == 0 || static_cast<uint32_t>(now - slot.receivedAt) > static_cast<uint32_t>(now - target->receivedAt)))
+        {
+            target = &slot;
+        }
+    }
+    if (!isCached && target->city != 0 && !evict)
+    {
+        return;
+    }
+    target->city = city;
+    target->check = check;
+    target->receivedAt = static_cast<uint32_t>(now);
+    target->weather = weather;
+}
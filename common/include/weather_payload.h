@@ -0,0 +1,63 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Fixed-layout binary weather payload published on <city>/bin, shared by the API and the display.
+ * Date: 9.December 2024
+ */
+
+#ifndef WEATHER_PAYLOAD_H
+#define WEATHER_PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "weather_tables.h"
+
+// Layout of version 1, all multi-byte fields little-endian:
+//   0     version
+//   1     mood id, a Mood value and index into MOOD_NAMES
+//   2..3  temperature in tenths of a degree Celsius, signed
+//   4     humidity in percent
+//   5     reserved, 0
+//   6..9  Unix time of the measurement
+const uint8_t WEATHER_PAYLOAD_VERSION = 1;
+const size_t WEATHER_PAYLOAD_SIZE = 10;
+
+struct WeatherPayload
+{
+    int16_t temperatureTenths;
+    uint8_t humidity;
+    uint8_t mood;
+    uint32_t timestamp;
+};
+
+inline void encodeWeatherPayload(const WeatherPayload &weather, uint8_t *out)
+{
+    uint16_t temperature = static_cast<uint16_t>(weather.temperatureTenths);
+    out[0] = WEATHER_PAYLOAD_VERSION;
+    out[1] = weather.mood;
+    out[2] = static_cast<uint8_t>(temperature & 0xFF);
+    out[3] = static_cast<uint8_t>(temperature >> 8);
+    out[4] = weather.humidity;
+    out[5] = 0;
+    out[6] = static_cast<uint8_t>(weather.timestamp & 0xFF);
+    out[7] = static_cast<uint8_t>((weather.timestamp >> 8) & 0xFF);
+    out[8] = static_cast<uint8_t>((weather.timestamp >> 16) & 0xFF);
+    out[9] = static_cast<uint8_t>(weather.timestamp >> 24);
+}
+
+// Returns false for a payload that is too short, of an unknown version or with an unknown mood
+inline bool decodeWeatherPayload(const uint8_t *data, size_t length, WeatherPayload &weather)
+{
+    if (length < WEATHER_PAYLOAD_SIZE || data[0] != WEATHER_PAYLOAD_VERSION || data[1] >= MOOD_COUNT)
+    {
+        return false;
+    }
+    weather.mood = data[1];
+    weather.temperatureTenths = static_cast<int16_t>(static_cast<uint16_t>(data[2] | (data[3] << 8)));
+    weather.humidity = data[4];
+    weather.timestamp = static_cast<uint32_t>(data[6]) | (static_cast<uint32_t>(data[7]) << 8) |
+                        (static_cast<uint32_t>(data[8]) << 16) | (static_cast<uint32_t>(data[9]) << 24);
+    return true;
+}
+
+#endif // WEATHER_PAYLOAD_H
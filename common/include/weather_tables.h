@@ -0,0 +1,144 @@
+/* Author: Jan Šulák
+ * Project: Display MQTT weather station
+ * Description: Compile-time tables of the moods and the featured cities with perfect hashes, shared by the API and the display.
+ * Date: 9.December 2024
+ */
+
+#ifndef WEATHER_TABLES_H
+#define WEATHER_TABLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The numeric values travel in the binary payload, append new moods at the end
+enum class Mood : uint8_t
+{
+    EXCITED,
+    HAPPY,
+    NEUTRAL,
+    SAD,
+    MISERABLE,
+};
+
+constexpr const char *MOOD_NAMES[] = {"Excited", "Happy", "Neutral", "Sad", "Miserable"};
+constexpr uint8_t MOOD_COUNT = sizeof(MOOD_NAMES) / sizeof(MOOD_NAMES[0]);
+static_assert(MOOD_COUNT == static_cast<uint8_t>(Mood::MISERABLE) + 1, "every mood needs a name");
+
+// Cities shown first on the display and prefetched by the API, with their OpenWeather IDs
+constexpr const char *FEATURED_CITY_NAMES[] = {"Brno", "Prague", "Ostrava", "Plzen", "Liberec",
+                                               "Olomouc", "Vienna", "Berlin", "Paris", "London"};
+constexpr long FEATURED_CITY_WEATHER_IDS[] = {3078610, 3067696, 3068799, 3068160, 3071961,
+                                              3069011, 2761369, 2950159, 2988507, 2643743};
+constexpr size_t FEATURED_CITY_COUNT = sizeof(FEATURED_CITY_NAMES) / sizeof(FEATURED_CITY_NAMES[0]);
+static_assert(FEATURED_CITY_COUNT == sizeof(FEATURED_CITY_WEATHER_IDS) / sizeof(FEATURED_CITY_WEATHER_IDS[0]),
+              "every featured city needs an OpenWeather ID");
+
+// Seeded FNV-1a over length bytes of name
+constexpr uint32_t tableHash(const char *name, size_t length, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < length; ++i)
+    {
+        h ^= static_cast<uint8_t>(name[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr size_t tableLength(const char *name)
+{
+    size_t length = 0;
+    while (name[length] != '\0')
+    {
+        length++;
+    }
+    return length;
+}
+
+constexpr bool tableEqual(const char *name, size_t length, const char *key)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (key[i] != name[i] || key[i] == '\0')
+        {
+            return false;
+        }
+    }
+    return key[length] == '\0';
+}
+
+// Perfect hash of a fixed set of names, found by trying seeds at compile time until no two names share a slot.
+// A lookup is one hash and one string comparison, with no heap and no tables in RAM.
+template <size_t N>
+class PerfectHash
+{
+public:
+    static constexpr size_t SLOTS = N * 2 <= 4 ? 4 : (N * 2 <= 8 ? 8 : (N * 2 <= 16 ? 16 : (N * 2 <= 32 ? 32 : 64)));
+    static_assert(N * 2 <= SLOTS && N < 255, "table too large for a compile-time perfect hash");
+
+    constexpr explicit PerfectHash(const char *const (&keys)[N]) : keys(keys), seed(0), slots()
+    {
+        for (uint32_t candidate = 1; candidate < 100000 && seed == 0; ++candidate)
+        {
+            for (size_t slot = 0; slot < SLOTS; ++slot)
+            {
+                slots[slot] = 0;
+            }
+            bool collision = false;
+            for (size_t i = 0; i < N && !collision; ++i)
+            {
+                size_t slot = tableHash(keys[i], tableLength(keys[i]), candidate) & (SLOTS - 1);
+                collision = slots[slot] != 0;
+                slots[slot] = static_cast<uint8_t>(i + 1);
+            }
+            if (!collision)
+            {
+                seed = candidate;
+            }
+        }
+    }
+
+    // Returns the index of the name in the table, or -1 if it is not one of the keys
+    constexpr int find(const char *name, size_t length) const
+    {
+        uint8_t entry = slots[tableHash(name, length, seed) & (SLOTS - 1)];
+        return entry != 0 && tableEqual(name, length, keys[entry - 1]) ? entry - 1 : -1;
+    }
+
+    constexpr bool valid() const { return seed != 0; }
+
+private:
+    const char *const (&keys)[N];
+    uint32_t seed;
+    uint8_t slots[SLOTS]; // Index of the key + 1, 0 for an empty slot
+};
+
+constexpr PerfectHash<MOOD_COUNT> MOOD_TABLE(MOOD_NAMES);
+constexpr PerfectHash<FEATURED_CITY_COUNT> FEATURED_CITY_TABLE(FEATURED_CITY_NAMES);
+static_assert(MOOD_TABLE.valid() && FEATURED_CITY_TABLE.valid(), "no perfect hash seed found");
+static_assert(MOOD_TABLE.find("Sad", 3) == static_cast<int>(Mood::SAD), "mood table out of sync");
+
+// Function to look up a mood name, returns false for an unknown one
+constexpr bool findMood(const char *name, size_t length, Mood &mood)
+{
+    int id = MOOD_TABLE.find(name, length);
+    if (id < 0)
+    {
+        return false;
+    }
+    mood = static_cast<Mood>(id);
+    return true;
+}
+
+constexpr const char *moodName(Mood mood)
+{
+    return static_cast<uint8_t>(mood) < MOOD_COUNT ? MOOD_NAMES[static_cast<uint8_t>(mood)] : "";
+}
+
+// Returns the index of a featured city, or -1 for any other city
+constexpr int findFeaturedCity(const char *name, size_t length)
+{
+    return FEATURED_CITY_TABLE.find(name, length);
+}
+
+#endif // WEATHER_TABLES_H